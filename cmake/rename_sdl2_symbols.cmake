@@ -0,0 +1,36 @@
+# Used by the DIRECTSDL2 build option: makes a copy of a static SDL2 library
+#  with every SDL_* symbol renamed to SDL20_*, so it can be linked into
+#  sdl12-compat without clashing with the SDL 1.2 API that we export.
+#
+# cmake -DNM=nm -DOBJCOPY=objcopy -DINPUT=libSDL2.a -DOUTPUT=out.a -P rename_sdl2_symbols.cmake
+
+foreach(var NM OBJCOPY INPUT OUTPUT)
+  if(NOT ${var})
+    message(FATAL_ERROR "rename_sdl2_symbols.cmake: ${var} isn't set")
+  endif()
+endforeach()
+
+execute_process(COMMAND "${NM}" -g --defined-only "${INPUT}"
+  OUTPUT_VARIABLE NM_OUTPUT
+  RESULT_VARIABLE NM_RESULT)
+if(NOT NM_RESULT EQUAL 0)
+  message(FATAL_ERROR "rename_sdl2_symbols.cmake: '${NM}' failed on ${INPUT}")
+endif()
+
+string(REGEX MATCHALL "[ \t]SDL_[A-Za-z0-9_]+" SDL2_SYMBOLS "${NM_OUTPUT}")
+list(REMOVE_DUPLICATES SDL2_SYMBOLS)
+
+set(SYMBOL_MAP "")
+foreach(sym ${SDL2_SYMBOLS})
+  string(STRIP "${sym}" sym)
+  string(SUBSTRING "${sym}" 4 -1 name)
+  set(SYMBOL_MAP "${SYMBOL_MAP}${sym} SDL20_${name}\n")
+endforeach()
+
+file(WRITE "${OUTPUT}.symbols" "${SYMBOL_MAP}")
+
+execute_process(COMMAND "${OBJCOPY}" "--redefine-syms=${OUTPUT}.symbols" "${INPUT}" "${OUTPUT}"
+  RESULT_VARIABLE OBJCOPY_RESULT)
+if(NOT OBJCOPY_RESULT EQUAL 0)
+  message(FATAL_ERROR "rename_sdl2_symbols.cmake: '${OBJCOPY}' failed on ${INPUT}")
+endif()
@@ -59,6 +59,7 @@
 
 #ifdef __linux__
 #include <unistd.h> /* for readlink() */
+#include <sys/mman.h> /* for mmap() and madvise() */
 #endif
 
 #if defined(__unix__) || defined(__APPLE__)
@@ -104,6 +105,11 @@ extern "C" {
 #define SDL20_SYM(rc,fn,params,args,ret) \
     typedef rc (SDLCALL *SDL20_##fn##_t) params; \
     static SDL20_##fn##_t SDL20_##fn = IGNORE_THIS_VERSION_OF_SDL_##fn;
+#elif defined(SDL12COMPAT_DIRECT_SDL2)
+/* SDL2 is statically linked in, with its symbols renamed to SDL20_*. See DIRECTSDL2 in CMakeLists.txt. */
+#define SDL20_SYM(rc,fn,params,args,ret) \
+    typedef rc (SDLCALL *SDL20_##fn##_t) params; \
+    extern rc SDLCALL SDL20_##fn params;
 #else
 #define SDL20_SYM(rc,fn,params,args,ret) \
     typedef rc (SDLCALL *SDL20_##fn##_t) params; \
@@ -301,13 +307,26 @@ typedef struct SDL12_Overlay
     Uint32 UnusedBits :31;
 } SDL12_Overlay;
 
+/* Each overlay gets a few textures, used in turn, so uploading the next
+   frame doesn't have to touch one that's still queued for the screen. */
+#define SDL12_YUV_TEXTURES 3
+
 typedef struct SDL12_YUVData  /* internal struct, not part of public SDL 1.2 API */
 {
-    SDL_Texture *texture20;
+    SDL_Texture *textures20[SDL12_YUV_TEXTURES];
+    int queued[SDL12_YUV_TEXTURES];  /* number of QueuedOverlayItems still using each texture. */
+    int current;  /* the texture with the latest upload in it. */
+    int locked;  /* texture the app is writing straight into (SDL12COMPAT_ZERO_COPY_OVERLAYS), or -1. */
     SDL_bool dirty;
     Uint8 *pixelbuf;
-    Uint8 *pixels[3];
+    Uint8 *pixels[3];  /* what the app sees: pixelbuf, or the locked texture's memory. */
     Uint16 pitches[3];
+    Uint8 *bufpixels[3];  /* where pixels[] points when not using a locked texture. */
+    Uint16 bufpitches[3];
+    Uint32 format20;
+    struct SDL12_Surface *target;  /* non-NULL for software overlays that draw into a surface other than the screen. */
+    SDL_Surface *rgb20;  /* software overlays: the last displayed frame, converted to RGB. */
+    Uint8 *packedbuf;  /* software overlays: planes rearranged the way SDL_ConvertPixels wants them, if necessary. */
 } SDL12_YUVData;
 
 typedef struct
@@ -941,6 +960,7 @@ typedef struct OpenGLEntryPoints
 typedef struct QueuedOverlayItem
 {
     SDL12_Overlay *overlay12;
+    int texture;  /* index into the overlay's textures20 array. */
     SDL12_Rect dstrect12;
     struct QueuedOverlayItem *next;
 } QueuedOverlayItem;
@@ -983,6 +1003,13 @@ static SDL_Window *VideoWindow20 = NULL;
 static SDL_Renderer *VideoRenderer20 = NULL;
 static SDL_mutex *VideoRendererLock = NULL;
 static SDL_Texture *VideoTexture20 = NULL;
+static Uint32 VideoRendererGeneration = 0;  /* bumped when VideoRenderer20 is destroyed, which destroys all its textures, too. */
+static SDL_bool VideoSurfaceHardwareBlits = SDL_FALSE;
+static SDL_bool VideoWindowSurfacePresent = SDL_FALSE;  /* drawing straight into the window surface instead of through VideoTexture20. */
+static SDL_Rect VideoWindowSurfaceDirty[64];
+static int VideoWindowSurfaceDirtyCount = 0;
+static SDL_bool VideoWindowSurfaceDirtyAll = SDL_FALSE;
+static int LiveYUVOverlays = 0;
 static SDL12_Surface VideoSurface12Location;
 static SDL12_Surface *VideoSurface12 = NULL;
 static SDL_Palette *VideoPhysicalPalette20 = NULL;
@@ -992,6 +1019,7 @@ static SDL_Surface *VideoConvertSurface20 = NULL;
 static SDL_GLContext VideoGLContext20 = NULL;
 static QueuedOverlayItem QueuedDisplayOverlays;  /* the head node */
 static QueuedOverlayItem *QueuedDisplayOverlaysTail = &QueuedDisplayOverlays;
+static QueuedOverlayItem *QueuedOverlayItemPool = NULL;  /* unused items, so video players don't malloc every frame. Protected by VideoRendererLock. */
 static char *WindowTitle = NULL;
 static char *WindowIconTitle = NULL;
 static SDL_Surface *VideoIcon20 = NULL;
@@ -1050,6 +1078,9 @@ static GLuint OpenGLLogicalScalingMultisampleColor = 0;
 static GLuint OpenGLLogicalScalingMultisampleDepth = 0;
 static GLuint OpenGLCurrentReadFBO = 0;
 static GLuint OpenGLCurrentDrawFBO = 0;
+static SDL_bool OpenGLLogicalScalingMultisampleDirty = SDL_TRUE;  /* SDL_TRUE if the multisample FBO might have changed since we last resolved it. */
+static Uint32 OpenGLMultisampleResolves = 0;
+static Uint32 OpenGLMultisampleResolvesSkipped = 0;
 static SDL_bool ForceGLSwapBufferContext = SDL_FALSE;
 static SDL12_TimerID AddedTimers = NULL;  /* we'll protect this with EventQueueMutex for laziness/convenience. */
 static SDL_mutex *EventQueueMutex = NULL;
@@ -1058,11 +1089,23 @@ static EventQueueType *EventQueueHead = NULL;
 static EventQueueType *EventQueueTail = NULL;
 static EventQueueType *EventQueueAvailable = NULL;
 static unsigned long SetVideoModeThread = 0;
+static SDL_bool VideoRendererKeepsContext = SDL_FALSE;  /* SDL_TRUE if we left the renderer's GL context current on SetVideoModeThread. */
+static SDL_bool VideoRendererThreaded = SDL_FALSE;  /* SDL_TRUE once the app might render from more than one thread. Never goes back. */
+static Uint32 VideoRendererContextReleases = 0;
 static SDL_bool VideoSurfaceUpdatedInBackgroundThread = SDL_FALSE;
 static SDL_bool AllowThreadedDraws = SDL_FALSE;
 static SDL_bool AllowThreadedPumps = SDL_FALSE;
 static SDL_bool WantCompatibilityAudioCVT = SDL_FALSE;
+static SDL_bool WantIntegerResampling = SDL_FALSE;
+static SDL_bool WantLowLatencyAudio = SDL_FALSE;
 static SDL_bool PreserveDestinationAlpha = SDL_TRUE;
+static int BandThreadCount = 0;
+static SDL_bool WantHardwareBlits = SDL_FALSE;
+static SDL_bool WantAlignedSurfaces = SDL_FALSE;
+static SDL_bool WantWindowSurfacePresent = SDL_FALSE;
+static SDL_bool WantZeroCopyOverlays = SDL_FALSE;
+static SDL_bool WantMSAAResolveTracking = SDL_FALSE;
+static SDL_bool WantGLContextAffinity = SDL_FALSE;
 static int DesiredRefreshRate = SDL12_REFRESH_DEFAULT;
 static int CurrentRefreshRate = SDL12_REFRESH_DEFAULT;
 
@@ -1244,6 +1287,15 @@ static SDL_bool SDL12COMPAT_CheckDebugLogging(void)
     return (value && SDL12COMPAT_strequal(value, "1")) ? SDL_TRUE : SDL_FALSE;
 }
 
+#ifndef SDL12COMPAT_DIRECT_SDL2
+/* same deal as SDL12COMPAT_CheckDebugLogging. */
+static SDL_bool SDL12COMPAT_CheckLazyBinding(void)
+{
+    const char *value = SDL12COMPAT_GetEnvAtStartup("SDL12COMPAT_LAZY_BINDING");
+    return (value && SDL12COMPAT_strequal(value, "1")) ? SDL_TRUE : SDL_FALSE;
+}
+#endif
+
 /* Obviously we can't use SDL_LoadObject() to load SDL2.  :)  */
 static char loaderror[256];
 #if defined(_WIN32)
@@ -1339,6 +1391,13 @@ static char loaderror[256];
 
         return SDL_FALSE; /* didn't find it anywhere reasonable. :( */
     }
+#elif defined(SDL12COMPAT_DIRECT_SDL2)
+    #include <dlfcn.h>
+    /* SDL2 is linked right into us, so there's nothing to load. */
+    #define SDL20_REQUIRED_VER SDL_VERSIONNUM(2,0,7)
+    static int Loaded_SDL20 = 0;
+    #define LoadSDL20Library() ((Loaded_SDL20 = 1) != 0)
+    #define CloseSDL20Library() { Loaded_SDL20 = 0; }
 #elif defined(__unix__)
     #include <dlfcn.h>
     #define SDL20_LIBNAME "libSDL2-2.0.so.0"
@@ -1355,6 +1414,7 @@ static char loaderror[256];
 #define DIRSEP "/"
 #endif
 
+#ifndef SDL12COMPAT_DIRECT_SDL2
 static void *
 LoadSDL20Symbol(const char *fn, int *okay)
 {
@@ -1370,11 +1430,16 @@ LoadSDL20Symbol(const char *fn, int *okay)
     return retval;
 }
 
+static void BindSDL20SymbolsLazily(void);
+#endif
+
 static void
 UnloadSDL20(void)
 {
+    #ifndef SDL12COMPAT_DIRECT_SDL2
     #define SDL20_SYM(rc,fn,params,args,ret) SDL20_##fn = NULL;
     #include "SDL20_syms.h"
+    #endif
     CloseSDL20Library();
 }
 
@@ -1584,6 +1649,198 @@ SDL12Compat_GetHintInt(const char *name, int default_value)
     return SDL20_atoi(val);
 }
 
+/* Every SDL12COMPAT_* setting that we consult after SDL_Init is parsed once
+   into HintConfig, so hot paths (and everything else) just read a field
+   instead of walking the environment and reparsing strings every time.
+   The snapshot is taken on first use, again whenever SDL_Init starts from
+   nothing, and whenever the app changes one of these through SDL_putenv.
+   Settings that are only checked at load time (SDL12COMPAT_DEBUG_LOGGING,
+   the quirks table, etc) and SDL12COMPAT_NO_UNLOAD still read the
+   environment directly, as there's nothing to snapshot there.
+   Tristate hints are -1 when unset, strings are NULL when unset. */
+#define SDL12COMPAT_HINTS \
+    HINT_BOOL(use_game_controllers, "SDL12COMPAT_USE_GAME_CONTROLLERS", SDL_FALSE) \
+    HINT_INT(max_bpp, "SDL12COMPAT_MAX_BPP", 32) \
+    HINT_BOOL(opengl_scaling, "SDL12COMPAT_OPENGL_SCALING", SDL_TRUE) \
+    HINT_BOOL(preserve_dest_alpha, "SDL12COMPAT_PRESERVE_DEST_ALPHA", SDL_TRUE) \
+    HINT_BOOL(dest_alpha_kernels, "SDL12COMPAT_DEST_ALPHA_KERNELS", SDL_TRUE) \
+    HINT_INT(blit_threads, "SDL12COMPAT_BLIT_THREADS", 0) \
+    HINT_BOOL(hw_blits, "SDL12COMPAT_HW_BLITS", SDL_FALSE) \
+    HINT_BOOL(aligned_surfaces, "SDL12COMPAT_ALIGNED_SURFACES", SDL_FALSE) \
+    HINT_BOOL(window_surface, "SDL12COMPAT_WINDOW_SURFACE", SDL_FALSE) \
+    HINT_BOOL(zero_copy_overlays, "SDL12COMPAT_ZERO_COPY_OVERLAYS", SDL_FALSE) \
+    HINT_BOOL(msaa_resolve_tracking, "SDL12COMPAT_MSAA_RESOLVE_TRACKING", SDL_FALSE) \
+    HINT_BOOL(gl_context_affinity, "SDL12COMPAT_GL_CONTEXT_AFFINITY", SDL_FALSE) \
+    HINT_STRING(max_vidmode, "SDL12COMPAT_MAX_VIDMODE") \
+    HINT_STRING(scale_method, "SDL12COMPAT_SCALE_METHOD") \
+    HINT_BOOL(allow_threaded_draws, "SDL12COMPAT_ALLOW_THREADED_DRAWS", SDL_TRUE) \
+    HINT_BOOL(allow_threaded_pumps, "SDL12COMPAT_ALLOW_THREADED_PUMPS", SDL_TRUE) \
+    HINT_TRISTATE(use_keyboard_layout, "SDL12COMPAT_USE_KEYBOARD_LAYOUT") \
+    HINT_BOOL(allow_syswm, "SDL12COMPAT_ALLOW_SYSWM", SDL_TRUE) \
+    HINT_BOOL(compatibility_audiocvt, "SDL12COMPAT_COMPATIBILITY_AUDIOCVT", SDL_FALSE) \
+    HINT_BOOL(integer_resampling, "SDL12COMPAT_INTEGER_RESAMPLING", SDL_FALSE) \
+    HINT_BOOL(low_latency_audio, "SDL12COMPAT_LOW_LATENCY_AUDIO", SDL_FALSE) \
+    HINT_BOOL(no_quit_video, "SDL12COMPAT_NO_QUIT_VIDEO", SDL_FALSE) \
+    HINT_BOOL(windowed_mode_list, "SDL12COMPAT_WINDOWED_MODE_LIST", SDL_FALSE) \
+    HINT_STRING(sync_to_vblank, "SDL12COMPAT_SYNC_TO_VBLANK") \
+    HINT_FLOAT(window_scaling, "SDL12COMPAT_WINDOW_SCALING", 1.0f) \
+    HINT_INT(max_fps, "SDL12COMPAT_MAX_FPS", 0) \
+    HINT_TRISTATE(highdpi, "SDL12COMPAT_HIGHDPI") \
+    HINT_TRISTATE(fix_borderless_fs_win, "SDL12COMPAT_FIX_BORDERLESS_FS_WIN") \
+    HINT_BOOL(force_gl_swapbuffer_context, "SDL12COMPAT_FORCE_GL_SWAPBUFFER_CONTEXT", SDL_FALSE) \
+    HINT_STRING(fake_cdrom_path, "SDL12COMPAT_FAKE_CDROM_PATH")
+
+typedef struct HintConfig
+{
+    #define HINT_BOOL(field, name, def) SDL_bool field;
+    #define HINT_INT(field, name, def) int field;
+    #define HINT_FLOAT(field, name, def) float field;
+    #define HINT_TRISTATE(field, name) int field;
+    #define HINT_STRING(field, name) char *field;
+    SDL12COMPAT_HINTS
+    #undef HINT_BOOL
+    #undef HINT_INT
+    #undef HINT_FLOAT
+    #undef HINT_TRISTATE
+    #undef HINT_STRING
+} HintConfig;
+
+/* SDL_putenv can replace the snapshot from any thread at any time, so it's
+   swapped in under Hints12Lock, and the strings in it must only be read
+   through CopyHintString/DupHintString, which take the lock too. Everything
+   else is a plain number, so just read it. */
+static HintConfig Hints12;
+static SDL_bool Hints12Loaded = SDL_FALSE;
+static SDL_SpinLock Hints12Lock = 0;
+
+static void
+FreeHintStrings(HintConfig *cfg)
+{
+    #define HINT_BOOL(field, name, def)
+    #define HINT_INT(field, name, def)
+    #define HINT_FLOAT(field, name, def)
+    #define HINT_TRISTATE(field, name)
+    #define HINT_STRING(field, name) SDL20_free(cfg->field); cfg->field = NULL;
+    SDL12COMPAT_HINTS
+    #undef HINT_BOOL
+    #undef HINT_INT
+    #undef HINT_FLOAT
+    #undef HINT_TRISTATE
+    #undef HINT_STRING
+}
+
+static void
+FreeHintConfig(void)
+{
+    HintConfig old;
+
+    SDL20_AtomicLock(&Hints12Lock);
+    SDL20_memcpy(&old, &Hints12, sizeof (HintConfig));
+    SDL20_zero(Hints12);
+    Hints12Loaded = SDL_FALSE;
+    SDL20_AtomicUnlock(&Hints12Lock);
+
+    FreeHintStrings(&old);
+}
+
+static void
+DumpHintConfig(const HintConfig *cfg)
+{
+    SDL20_Log("sdl12-compat effective configuration:");
+    #define HINT_BOOL(field, name, def) SDL20_Log("  %s=%d", name, (int) cfg->field);
+    #define HINT_INT(field, name, def) SDL20_Log("  %s=%d", name, cfg->field);
+    #define HINT_FLOAT(field, name, def) SDL20_Log("  %s=%f", name, (double) cfg->field);
+    #define HINT_TRISTATE(field, name) \
+        if (cfg->field < 0) { SDL20_Log("  %s=(unset)", name); } else { SDL20_Log("  %s=%d", name, cfg->field); }
+    #define HINT_STRING(field, name) SDL20_Log("  %s=%s", name, cfg->field ? cfg->field : "(unset)");
+    SDL12COMPAT_HINTS
+    #undef HINT_BOOL
+    #undef HINT_INT
+    #undef HINT_FLOAT
+    #undef HINT_TRISTATE
+    #undef HINT_STRING
+}
+
+static void
+RefreshHintConfig(void)
+{
+    HintConfig cfg, old;
+    const char *str;
+
+    /* build the new snapshot on the side, so the lock is only held for the swap. */
+    #define HINT_BOOL(field, name, def) cfg.field = SDL12Compat_GetHintBoolean(name, def);
+    #define HINT_INT(field, name, def) cfg.field = SDL12Compat_GetHintInt(name, def);
+    #define HINT_FLOAT(field, name, def) cfg.field = SDL12Compat_GetHintFloat(name, def);
+    #define HINT_TRISTATE(field, name) \
+        str = SDL12Compat_GetHint(name); \
+        cfg.field = str ? ((SDL20_atoi(str) != 0) ? 1 : 0) : -1;
+    #define HINT_STRING(field, name) \
+        str = SDL12Compat_GetHint(name); \
+        cfg.field = str ? SDL20_strdup(str) : NULL;
+    SDL12COMPAT_HINTS
+    #undef HINT_BOOL
+    #undef HINT_INT
+    #undef HINT_FLOAT
+    #undef HINT_TRISTATE
+    #undef HINT_STRING
+
+    if (WantDebugLogging) {
+        DumpHintConfig(&cfg);
+    }
+
+    SDL20_AtomicLock(&Hints12Lock);
+    SDL20_memcpy(&old, &Hints12, sizeof (HintConfig));
+    SDL20_memcpy(&Hints12, &cfg, sizeof (HintConfig));
+    Hints12Loaded = SDL_TRUE;
+    SDL20_AtomicUnlock(&Hints12Lock);
+
+    FreeHintStrings(&old);
+}
+
+static const HintConfig *
+GetHintConfig(void)
+{
+    if (!Hints12Loaded) {
+        RefreshHintConfig();
+    }
+    return &Hints12;
+}
+
+/* Copies a string hint (like &GetHintConfig()->max_vidmode) into buf.
+   Returns SDL_FALSE, and leaves buf alone, if the hint isn't set. */
+static SDL_bool
+CopyHintString(char *const *field, char *buf, const size_t buflen)
+{
+    SDL_bool retval = SDL_FALSE;
+    SDL20_AtomicLock(&Hints12Lock);
+    if (*field) {
+        SDL20_strlcpy(buf, *field, buflen);
+        retval = SDL_TRUE;
+    }
+    SDL20_AtomicUnlock(&Hints12Lock);
+    return retval;
+}
+
+/* Same as CopyHintString, but returns an SDL20_malloc'd copy (or NULL if unset). */
+static char *
+DupHintString(char *const *field)
+{
+    char *retval = NULL;
+    SDL20_AtomicLock(&Hints12Lock);
+    if (*field) {
+        retval = SDL20_strdup(*field);
+    }
+    SDL20_AtomicUnlock(&Hints12Lock);
+    return retval;
+}
+
+/* for tristate hints: the hint's value if it was set, otherwise default_value. */
+static SDL_bool
+HintTristate(const int value, const SDL_bool default_value)
+{
+    return (value < 0) ? default_value : (value ? SDL_TRUE : SDL_FALSE);
+}
+
 /* DO NOT USE SDL2 FUNCTIONS IN HERE! */
 static void
 SDL12Compat_ApplyQuirks(SDL_bool force_x11)
@@ -1690,6 +1947,9 @@ LoadSDL20(void)
     int okay = 1;
     if (!Loaded_SDL20) {
         SDL_bool force_x11 = SDL_FALSE;
+        #ifndef SDL12COMPAT_DIRECT_SDL2
+        SDL_bool lazy_binding = SDL_FALSE;
+        #endif
 
         #ifdef __linux__
         void *global_symbols = dlopen(NULL, RTLD_LOCAL|RTLD_NOW);
@@ -1708,13 +1968,27 @@ LoadSDL20(void)
         #endif
 
         WantDebugLogging = SDL12COMPAT_CheckDebugLogging();
+        #ifndef SDL12COMPAT_DIRECT_SDL2
+        lazy_binding = SDL12COMPAT_CheckLazyBinding();
+        #endif
 
         okay = LoadSDL20Library();
         if (!okay) {
             SDL12COMPAT_stpcpy(loaderror, "sdl12-compat: Failed loading SDL2 library.");
         } else {
-            #define SDL20_SYM(rc,fn,params,args,ret) SDL20_##fn = (SDL20_##fn##_t) LoadSDL20Symbol("SDL_" #fn, &okay);
-            #include "SDL20_syms.h"
+            #ifndef SDL12COMPAT_DIRECT_SDL2
+            if (lazy_binding) {
+                /* varargs functions can't go through a trampoline, and the version check needs to work now. Everything else binds on first use. */
+                #define SDL20_SYM(rc,fn,params,args,ret)
+                #define SDL20_SYM_VARARGS(rc,fn,params) SDL20_##fn = (SDL20_##fn##_t) LoadSDL20Symbol("SDL_" #fn, &okay);
+                #include "SDL20_syms.h"
+                SDL20_GetVersion = (SDL20_GetVersion_t) LoadSDL20Symbol("SDL_GetVersion", &okay);
+                BindSDL20SymbolsLazily();
+            } else {
+                #define SDL20_SYM(rc,fn,params,args,ret) SDL20_##fn = (SDL20_##fn##_t) LoadSDL20Symbol("SDL_" #fn, &okay);
+                #include "SDL20_syms.h"
+            }
+            #endif
             if (okay) {
                 char sdl2verstr[16];
                 char sdl2reqverstr[16];
@@ -1817,6 +2091,45 @@ static void error_dialog(const char *errorMsg)
 }
 #endif
 
+#ifndef SDL12COMPAT_DIRECT_SDL2
+/* SDL12COMPAT_LAZY_BINDING=1 support: every SDL20_* pointer starts out pointing
+   at one of these, which looks up the real function, replaces the pointer
+   with it, and calls it. Two threads racing here will just both store the
+   same value. If SDL2 doesn't have the function, there's nothing sensible to
+   do but complain about it like we would have at startup. */
+static void *
+LoadSDL20SymbolLazily(const char *fn)
+{
+    int okay = 1;
+    void *retval = LoadSDL20Symbol(fn, &okay);
+    if (!okay) {
+        error_dialog(loaderror);
+        #ifdef _WIN32
+        ExitProcess(42);  /* no C runtime here. */
+        #else
+        abort();
+        #endif
+    }
+    return retval;
+}
+
+#define SDL20_SYM(rc,fn,params,args,ret) \
+    static rc SDLCALL SDL20_Lazy_##fn params { \
+        SDL20_##fn = (SDL20_##fn##_t) LoadSDL20SymbolLazily("SDL_" #fn); \
+        ret SDL20_##fn args; \
+    }
+#define SDL20_SYM_VARARGS(rc,fn,params)
+#include "SDL20_syms.h"
+
+static void
+BindSDL20SymbolsLazily(void)
+{
+    #define SDL20_SYM(rc,fn,params,args,ret) if (!SDL20_##fn) { SDL20_##fn = SDL20_Lazy_##fn; }
+    #define SDL20_SYM_VARARGS(rc,fn,params)
+    #include "SDL20_syms.h"
+}
+#endif
+
 #if defined(__GNUC__) && !defined(_WIN32)
 static void dllinit(void) __attribute__((constructor));
 static void dllinit(void)
@@ -1912,6 +2225,90 @@ SDL_Linked_Version(void)
     return &version;
 }
 
+/* Startup phase timing. SDL_Init and SDL_SetVideoMode can stall for a long
+   time on some systems, and it's hard to say where from the outside, so we
+   time the expensive parts of them with the performance counter. Results
+   are logged with SDL12COMPAT_DEBUG_LOGGING, and apps (or test harnesses)
+   can ask for them with SDL12COMPAT_GetStartupPhase(). */
+typedef enum
+{
+    STARTUP_PHASE_INIT,  /* SDL20_Init itself. */
+    STARTUP_PHASE_VIDEO_MODES,
+    STARTUP_PHASE_JOYSTICKS,
+    STARTUP_PHASE_OPEN_AUDIO,
+    STARTUP_PHASE_SET_VIDEO_MODE,  /* all of SDL_SetVideoMode, including the phases below. */
+    STARTUP_PHASE_CREATE_WINDOW,
+    STARTUP_PHASE_CREATE_RENDERER,
+    STARTUP_PHASE_CREATE_TEXTURE,
+    STARTUP_PHASE_GL_CONTEXT,
+    STARTUP_PHASE_GL_FUNCTIONS,
+    STARTUP_PHASE_GL_SCALING,
+    STARTUP_PHASE_MAX
+} StartupPhase;
+
+static const char *StartupPhaseNames[STARTUP_PHASE_MAX] = {
+    "SDL_Init", "video modes", "joysticks", "audio device", "SDL_SetVideoMode",
+    "window", "renderer", "screen texture", "GL context", "GL functions", "GL scaling"
+};
+
+typedef struct StartupPhaseTiming
+{
+    Uint64 last;  /* performance counter ticks. */
+    Uint64 total;
+    Uint32 count;
+} StartupPhaseTiming;
+
+static StartupPhaseTiming StartupPhaseTimings[STARTUP_PHASE_MAX];
+
+static Uint64
+BeginStartupPhase(void)
+{
+    return SDL20_GetPerformanceCounter();
+}
+
+static void
+EndStartupPhase(const StartupPhase phase, const Uint64 start)
+{
+    StartupPhaseTiming *timing = &StartupPhaseTimings[phase];
+    timing->last = SDL20_GetPerformanceCounter() - start;
+    timing->total += timing->last;
+    timing->count++;
+
+    if (WantDebugLogging) {
+        SDL20_Log("Startup phase '%s' took %.3f ms", StartupPhaseNames[phase],
+                  (timing->last * 1000.0) / (double) SDL20_GetPerformanceFrequency());
+    }
+}
+
+/* Returns -1 if there's no phase at `index`, so you can loop until it fails.
+   The times are in milliseconds: the most recent run of the phase and the sum
+   of all of them. Any of the pointers can be NULL. */
+DECLSPEC12 int SDLCALL
+SDL12COMPAT_GetStartupPhase(int index, const char **name, double *last_ms, double *total_ms, Uint32 *count)
+{
+    const double freq = (double) SDL20_GetPerformanceFrequency();
+    const StartupPhaseTiming *timing;
+
+    if ((index < 0) || (index >= STARTUP_PHASE_MAX)) {
+        return -1;
+    }
+
+    timing = &StartupPhaseTimings[index];
+    if (name) {
+        *name = StartupPhaseNames[index];
+    }
+    if (last_ms) {
+        *last_ms = (timing->last * 1000.0) / freq;
+    }
+    if (total_ms) {
+        *total_ms = (timing->total * 1000.0) / freq;
+    }
+    if (count) {
+        *count = timing->count;
+    }
+    return 0;
+}
+
 DECLSPEC12 int SDLCALL
 SDL_sscanf(const char *text, const char *fmt, ...)
 {
@@ -2073,7 +2470,7 @@ Init12Joystick(void)
     int numsticks20;
     int i;
 
-    JoysticksAreGameControllers = SDL12Compat_GetHintBoolean("SDL12COMPAT_USE_GAME_CONTROLLERS", SDL_FALSE);
+    JoysticksAreGameControllers = GetHintConfig()->use_game_controllers;
     NumJoysticks = 0;
 
     SDL20_LockJoysticks();
@@ -2325,8 +2722,11 @@ BPPToPixelFormat(unsigned bpp)
     }
 }
 
+/* This fills in everything but format20->format, which needs a fairly expensive
+   SDL20_MasksToPixelFormatEnum call, and which SDL2's MapRGB/GetRGB functions
+   don't look at anyhow. Use PixelFormat12to20 if you need a complete format. */
 static SDL_PixelFormat *
-PixelFormat12to20(SDL_PixelFormat *format20, SDL_Palette *palette20, const SDL12_PixelFormat *format12)
+PixelFormat12to20NoEnum(SDL_PixelFormat *format20, SDL_Palette *palette20, const SDL12_PixelFormat *format12)
 {
     if (format12->palette) {
         palette20->ncolors = format12->palette->ncolors;
@@ -2338,7 +2738,7 @@ PixelFormat12to20(SDL_PixelFormat *format20, SDL_Palette *palette20, const SDL12
         format20->palette = NULL;
     }
 
-    format20->format = SDL20_MasksToPixelFormatEnum(format12->BitsPerPixel, format12->Rmask, format12->Gmask, format12->Bmask, format12->Amask);
+    format20->format = SDL_PIXELFORMAT_UNKNOWN;
     format20->BitsPerPixel = format12->BitsPerPixel;
     format20->BytesPerPixel = format12->BytesPerPixel;
 
@@ -2375,6 +2775,14 @@ PixelFormat12to20(SDL_PixelFormat *format20, SDL_Palette *palette20, const SDL12
     return format20;
 }
 
+static SDL_PixelFormat *
+PixelFormat12to20(SDL_PixelFormat *format20, SDL_Palette *palette20, const SDL12_PixelFormat *format12)
+{
+    PixelFormat12to20NoEnum(format20, palette20, format12);
+    format20->format = SDL20_MasksToPixelFormatEnum(format12->BitsPerPixel, format12->Rmask, format12->Gmask, format12->Bmask, format12->Amask);
+    return format20;
+}
+
 static SDL12_PixelFormat *
 PixelFormat20to12(SDL12_PixelFormat *format12, SDL12_Palette *palette12, const SDL_PixelFormat *format20)
 {
@@ -2508,14 +2916,14 @@ static int
 Init12VidModes(void)
 {
     const int total = SDL20_GetNumDisplayModes(VideoDisplayIndex);
-    const char *maxmodestr;
-    const unsigned max_bpp = SDL12Compat_GetHintInt("SDL12COMPAT_MAX_BPP", 32);
+    char maxmodestr[32];
+    const unsigned max_bpp = GetHintConfig()->max_bpp;
     VideoModeList *vmode = NULL;
     void *ptr = NULL;
     int i, j;
     SDL12_Rect prev_mode = { 0, 0, 0, 0 }, current_mode = { 0, 0, 0, 0 };
     /* We only want to enable fake modes if OpenGL Logical Scaling is enabled. */
-    const SDL_bool use_fake_modes = SDL12Compat_GetHintBoolean("SDL12COMPAT_OPENGL_SCALING", SDL_TRUE);
+    const SDL_bool use_fake_modes = GetHintConfig()->opengl_scaling;
     Uint16 maxw = 0;
     Uint16 maxh = 0;
 
@@ -2523,13 +2931,19 @@ Init12VidModes(void)
         return 0;  /* already did this. */
     }
 
-    PreserveDestinationAlpha = SDL12Compat_GetHintBoolean("SDL12COMPAT_PRESERVE_DEST_ALPHA", SDL_TRUE);
+    PreserveDestinationAlpha = GetHintConfig()->preserve_dest_alpha;
+    BandThreadCount = GetHintConfig()->blit_threads;
+    WantHardwareBlits = GetHintConfig()->hw_blits;
+    WantAlignedSurfaces = GetHintConfig()->aligned_surfaces;
+    WantWindowSurfacePresent = GetHintConfig()->window_surface;
+    WantZeroCopyOverlays = GetHintConfig()->zero_copy_overlays;
+    WantMSAAResolveTracking = GetHintConfig()->msaa_resolve_tracking;
+    WantGLContextAffinity = GetHintConfig()->gl_context_affinity;
     WantOpenGLScaling = use_fake_modes;
 
     SDL_assert(VideoModes == NULL);
 
-    maxmodestr = SDL12Compat_GetHint("SDL12COMPAT_MAX_VIDMODE");
-    if (maxmodestr) {
+    if (CopyHintString(&GetHintConfig()->max_vidmode, maxmodestr, sizeof (maxmodestr))) {
         unsigned int w = 0, h = 0;
         SDL_sscanf(maxmodestr, "%ux%u", &w, &h);
         if (w > 0xFFFF) w = 0xFFFF;
@@ -2677,18 +3091,19 @@ static int
 Init12Video(void)
 {
     const char *driver = SDL20_GetCurrentVideoDriver();
-    const char *scale_method_env = SDL12Compat_GetHint("SDL12COMPAT_SCALE_METHOD");
-    const unsigned max_bpp = SDL12Compat_GetHintInt("SDL12COMPAT_MAX_BPP", 32);
+    const unsigned max_bpp = GetHintConfig()->max_bpp;
+    char scale_method_env[16];
     SDL_DisplayMode mode;
+    Uint64 phase_start;
     int i;
 
-    AllowThreadedDraws = SDL12Compat_GetHintBoolean("SDL12COMPAT_ALLOW_THREADED_DRAWS", SDL_TRUE);
-    AllowThreadedPumps = SDL12Compat_GetHintBoolean("SDL12COMPAT_ALLOW_THREADED_PUMPS", SDL_TRUE);
+    AllowThreadedDraws = GetHintConfig()->allow_threaded_draws;
+    AllowThreadedPumps = GetHintConfig()->allow_threaded_pumps;
 
-    WantScaleMethodNearest = (scale_method_env && !SDL20_strcmp(scale_method_env, "nearest")) ? SDL_TRUE : SDL_FALSE;
+    WantScaleMethodNearest = (CopyHintString(&GetHintConfig()->scale_method, scale_method_env, sizeof (scale_method_env)) && !SDL20_strcmp(scale_method_env, "nearest")) ? SDL_TRUE : SDL_FALSE;
 
     /* Only override this if the env var is set, as the default is platform-specific. */
-    TranslateKeyboardLayout = SDL12Compat_GetHintBoolean("SDL12COMPAT_USE_KEYBOARD_LAYOUT", TranslateKeyboardLayout);
+    TranslateKeyboardLayout = HintTristate(GetHintConfig()->use_keyboard_layout, TranslateKeyboardLayout);
 
     IsDummyVideo = ((driver != NULL) && (SDL20_strcmp(driver, "dummy") == 0)) ? SDL_TRUE : SDL_FALSE;
 
@@ -2724,7 +3139,7 @@ Init12Video(void)
     SupportSysWM = SDL_FALSE;
 #endif
 
-    if (!SDL12Compat_GetHintBoolean("SDL12COMPAT_ALLOW_SYSWM", SDL_TRUE)) {
+    if (!GetHintConfig()->allow_syswm) {
         SupportSysWM = SDL_FALSE;
     }
 
@@ -2741,9 +3156,12 @@ Init12Video(void)
     VideoCursorHidden = SDL_FALSE;
     SDL20_ShowCursor(1);
 
+    phase_start = BeginStartupPhase();
     if (Init12VidModes() < 0) {
+        EndStartupPhase(STARTUP_PHASE_VIDEO_MODES, phase_start);
         return -1;
     }
+    EndStartupPhase(STARTUP_PHASE_VIDEO_MODES, phase_start);
 
     SDL20_StopTextInput();
 
@@ -2783,12 +3201,15 @@ SDL_VideoInit(const char *driver, Uint32 flags)
 static void
 Init12Audio(void)
 {
-    WantCompatibilityAudioCVT = SDL12Compat_GetHintBoolean("SDL12COMPAT_COMPATIBILITY_AUDIOCVT", SDL_FALSE);
+    WantCompatibilityAudioCVT = GetHintConfig()->compatibility_audiocvt;
+    WantIntegerResampling = GetHintConfig()->integer_resampling;
+    WantLowLatencyAudio = GetHintConfig()->low_latency_audio;
 }
 
 
 static void InitializeCDSubsystem(void);
 static void QuitCDSubsystem(void);
+static void FreeCVTStreamCache(void);
 
 
 DECLSPEC12 int SDLCALL
@@ -2797,6 +3218,7 @@ SDL_InitSubSystem(Uint32 sdl12flags)
     const char *videodriver = SDL12COMPAT_getenv_unsafe("SDL_VIDEODRIVER");
     const char *audiodriver = SDL12COMPAT_getenv_unsafe("SDL_AUDIODRIVER");
     Uint32 sdl20flags = 0;
+    Uint64 phase_start;
     int rc;
 
 #ifdef __WINDOWS__
@@ -2814,6 +3236,11 @@ SDL_InitSubSystem(Uint32 sdl12flags)
     sdl12_compat_macos_init();
 #endif
 
+    /* starting up from nothing? Take a fresh look at the environment. */
+    if (InitializedSubsystems20 == 0) {
+        RefreshHintConfig();
+    }
+
     /* note that currently we ignore SDL12_INIT_NOPARACHUTE, since
        there _isn't_ a parachute in SDL2, and mostly it was meant to deal
        with X11's XVidMode leaving the display resolution busted if the app
@@ -2855,7 +3282,10 @@ SDL_InitSubSystem(Uint32 sdl12flags)
         SDL20_SetHintWithPriority(SDL_HINT_AUDIODRIVER, audiodriver, SDL_HINT_OVERRIDE);
     }
 
+    phase_start = BeginStartupPhase();
     rc = SDL20_Init(sdl20flags);
+    EndStartupPhase(STARTUP_PHASE_INIT, phase_start);
+
     if ((rc == 0) && (sdl20flags & SDL_INIT_VIDEO)) {
         if (Init12Video() < 0) {
             rc = -1;
@@ -2870,7 +3300,9 @@ SDL_InitSubSystem(Uint32 sdl12flags)
     }
 
     if ((rc == 0) && (sdl20flags & SDL_INIT_JOYSTICK)) {
+        phase_start = BeginStartupPhase();
         Init12Joystick();  /* if this fails, we just won't report any sticks. */
+        EndStartupPhase(STARTUP_PHASE_JOYSTICKS, phase_start);
     }
 
     InitializedSubsystems20 |= sdl20flags;
@@ -2933,24 +3365,244 @@ SDL_WasInit(Uint32 sdl12flags)
     return InitFlags20to12(SDL20_WasInit(sdl20flags)) | extraflags;
 }
 
+/* Every 1.2 surface needs an SDL12_Surface and an SDL12_PixelFormat (and
+   maybe an SDL12_Palette) wrapped around the SDL2 surface. Apps that make
+   thousands of tiny surfaces (font glyph caches, tile sets) would churn the
+   heap with these, so we carve them out of slabs and keep free lists per
+   wrapper type. The format and palette of a surface always live and die
+   together, so they share one allocation.
+
+   We can't share formats between surfaces with the same masks, even though
+   that looks tempting: in 1.2, colorkey and per-surface alpha live in the
+   format struct, and apps poke at those directly. */
+typedef struct SurfaceFormat12
+{
+    SDL12_PixelFormat format;
+    SDL12_Palette palette;
+} SurfaceFormat12;
+
+typedef union WrapperPoolItem
+{
+    union WrapperPoolItem *next;  /* only valid while on the free list. */
+    SDL12_Surface surface;
+    SurfaceFormat12 format;
+} WrapperPoolItem;
+
+typedef struct WrapperPoolSlab
+{
+    struct WrapperPoolSlab *next;
+    WrapperPoolItem items[64];
+} WrapperPoolSlab;
+
+typedef struct WrapperPool
+{
+    const char *name;
+    size_t itemsize;
+    WrapperPoolItem *freelist;
+    WrapperPoolSlab *slabs;
+    int num_slabs;
+    int live;
+    int peak;
+} WrapperPool;
+
+static SDL_SpinLock WrapperPoolLock = 0;
+static WrapperPool SurfaceWrapperPool = { "SDL12_Surface", sizeof (SDL12_Surface), NULL, NULL, 0, 0, 0 };
+static WrapperPool FormatWrapperPool = { "SDL12_PixelFormat", sizeof (SurfaceFormat12), NULL, NULL, 0, 0, 0 };
+
+static void *
+AllocWrapper(WrapperPool *pool)
+{
+    WrapperPoolItem *item;
+
+    SDL20_AtomicLock(&WrapperPoolLock);
+    if (!pool->freelist) {
+        /* Slabs are sized for the largest wrapper, so one slab type serves every pool. */
+        WrapperPoolSlab *slab = (WrapperPoolSlab *) SDL20_malloc(sizeof (WrapperPoolSlab));
+        if (slab) {
+            int i;
+            for (i = 0; i < (int) SDL_arraysize(slab->items); i++) {
+                slab->items[i].next = pool->freelist;
+                pool->freelist = &slab->items[i];
+            }
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->num_slabs++;
+        }
+    }
+
+    item = pool->freelist;
+    if (item) {
+        pool->freelist = item->next;
+        pool->live++;
+        if (pool->live > pool->peak) {
+            pool->peak = pool->live;
+        }
+    }
+    SDL20_AtomicUnlock(&WrapperPoolLock);
+
+    if (!item) {
+        SDL20_OutOfMemory();
+        return NULL;
+    }
+
+    SDL20_memset(item, '\0', pool->itemsize);
+    return item;
+}
+
+static void
+FreeWrapper(WrapperPool *pool, void *ptr)
+{
+    if (ptr) {
+        WrapperPoolItem *item = (WrapperPoolItem *) ptr;
+        SDL20_AtomicLock(&WrapperPoolLock);
+        item->next = pool->freelist;
+        pool->freelist = item;
+        pool->live--;
+        SDL20_AtomicUnlock(&WrapperPoolLock);
+    }
+}
+
+/* Surfaces can outlive the video subsystem, so this only gives the slabs
+   back if nothing is using them anymore. */
+static void
+QuitWrapperPool(WrapperPool *pool)
+{
+    SDL20_AtomicLock(&WrapperPoolLock);
+    if (WantDebugLogging) {
+        SDL20_Log("%s wrappers: %d slabs, %d peak, %d still live", pool->name, pool->num_slabs, pool->peak, pool->live);
+    }
+    if (pool->live == 0) {
+        WrapperPoolSlab *slab = pool->slabs;
+        while (slab) {
+            WrapperPoolSlab *next = slab->next;
+            SDL20_free(slab);
+            slab = next;
+        }
+        pool->slabs = NULL;
+        pool->freelist = NULL;
+        pool->num_slabs = 0;
+        pool->peak = 0;
+    }
+    SDL20_AtomicUnlock(&WrapperPoolLock);
+}
+
+/* Pixels for surfaces we allocate ourselves (the screen, and big surfaces
+   when SDL12COMPAT_ALIGNED_SURFACES is enabled). The pointer we hand out is
+   aligned to a cache line, and the real allocation is stashed just in front
+   of it so we can free it later. On Linux, big buffers come straight from
+   mmap(), lined up on a 2MB boundary, and we ask the kernel to back them
+   with huge pages, since blitting a whole screen every frame otherwise
+   walks through hundreds of 4K pages. Either way, the memory is zeroed. */
+#define SURFACE_PIXELS_ALIGNMENT 64
+#define SURFACE_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct SurfacePixelsHeader
+{
+    void *base;
+    size_t mapped_len;  /* nonzero if this came from mmap(). */
+} SurfacePixelsHeader;
+
+static void *
+AllocSurfacePixels(size_t len)
+{
+    SurfacePixelsHeader *header;
+    Uint8 *base;
+    Uint8 *pixels;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (len >= SURFACE_HUGEPAGE_SIZE) {
+        const size_t maplen = len + SURFACE_PIXELS_ALIGNMENT + SURFACE_HUGEPAGE_SIZE;
+        base = (Uint8 *) mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != (Uint8 *) MAP_FAILED) {
+            Uint8 *huge = (Uint8 *) ((((uintptr_t) base) + (SURFACE_HUGEPAGE_SIZE - 1)) & ~((uintptr_t) (SURFACE_HUGEPAGE_SIZE - 1)));
+            madvise(huge, maplen - (size_t) (huge - base), MADV_HUGEPAGE);  /* just a hint; if this fails, we still have our memory. */
+            pixels = huge + SURFACE_PIXELS_ALIGNMENT;
+            header = ((SurfacePixelsHeader *) pixels) - 1;
+            header->base = base;
+            header->mapped_len = maplen;
+            return pixels;
+        }
+    }
+#endif
+
+    base = (Uint8 *) SDL20_calloc(1, len + sizeof (SurfacePixelsHeader) + (SURFACE_PIXELS_ALIGNMENT - 1));
+    if (!base) {
+        return NULL;
+    }
+    pixels = (Uint8 *) ((((uintptr_t) base) + sizeof (SurfacePixelsHeader) + (SURFACE_PIXELS_ALIGNMENT - 1)) & ~((uintptr_t) (SURFACE_PIXELS_ALIGNMENT - 1)));
+    header = ((SurfacePixelsHeader *) pixels) - 1;
+    header->base = base;
+    header->mapped_len = 0;
+    return pixels;
+}
+
+static void
+FreeSurfacePixels(void *pixels)
+{
+    if (pixels) {
+        const SurfacePixelsHeader *header = ((const SurfacePixelsHeader *) pixels) - 1;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (header->mapped_len) {
+            munmap(header->base, header->mapped_len);
+            return;
+        }
+#endif
+        SDL20_free(header->base);
+    }
+}
+
+/* Pad rows out to a cache line, if the app opted in. Lots of 1.2 apps
+   assume pitch == w * bpp, so this is off by default, and we only do it
+   when it keeps every row starting on a pixel boundary (GL_UNPACK_ROW_LENGTH
+   for OPENGLBLIT needs that) and when rows are big enough to be worth it. */
+static int
+SurfacePitch12(int width, int bpp)
+{
+    const int pitch = width * bpp;
+    if (WantAlignedSurfaces && (bpp > 0) && ((SURFACE_PIXELS_ALIGNMENT % bpp) == 0) && (pitch >= 256)) {
+        const int aligned = (pitch + (SURFACE_PIXELS_ALIGNMENT - 1)) & ~(SURFACE_PIXELS_ALIGNMENT - 1);
+        if (aligned <= 65535) {  /* SDL 1.2's pitch is a Uint16. */
+            return aligned;
+        }
+    }
+    return pitch;
+}
+
+static void FreeHardwareSurface(SDL12_Surface *surface12);
+static void SurfaceWillChange12(SDL12_Surface *surface12);
+static void SurfaceWillBeRead12(SDL12_Surface *surface12);
+static void DiscardDisplayList(void);
+static void MarkHardwareSurface(SDL12_Surface *surface12);
+static void ForgetPaletteMaps(const SDL_Palette *palette);
+
 static void
 FreeSurfaceContents(SDL12_Surface *surface12)
 {
+    FreeHardwareSurface(surface12);
     if (surface12->surface20) {
+        /* SDL2 thinks pixels we allocated ourselves are the app's; see CreateRGBSurface20. */
+        void *ownedpixels = NULL;
+        if ((surface12->surface20->flags & SDL_PREALLOC) && !(surface12->flags & SDL12_PREALLOC)) {
+            ownedpixels = surface12->pixels;
+        }
         if (surface12->pixels == NULL) {
             surface12->surface20->pixels = NULL;
         }
+        ForgetPaletteMaps(surface12->surface20->format->palette);
         SDL20_FreeSurface(surface12->surface20);
         surface12->surface20 = NULL;
+        FreeSurfacePixels(ownedpixels);
     }
     if (surface12->format) {
-        SDL20_free(surface12->format->palette);
-        SDL20_free(surface12->format);
+        FreeWrapper(&FormatWrapperPool, surface12->format);  /* the palette is part of the same allocation. */
         surface12->format = NULL;
     }
 }
 
 static SDL12_Surface *EndVidModeCreate(void);
+static void QuitBandWorkers(void);
+static void FreeStretchColumns(void);
+static void FreePaletteMapCache(void);
 static void
 Quit12Video(void)
 {
@@ -2990,6 +3642,12 @@ Quit12Video(void)
 
     /* Shutdown the fake event thread. */
     EventThreadEnabled = SDL_FALSE;
+
+    QuitBandWorkers();
+    FreeStretchColumns();
+    FreePaletteMapCache();
+    QuitWrapperPool(&SurfaceWrapperPool);
+    QuitWrapperPool(&FormatWrapperPool);
 }
 
 DECLSPEC12 void SDLCALL
@@ -3001,7 +3659,7 @@ SDL_QuitSubSystem(Uint32 sdl12flags)
      * SDL_Quit(SDL_INIT_VIDEO) on resolution change, and never call
      * SDL_Init() again before creating their new window.
      */
-    if (SDL12Compat_GetHintBoolean("SDL12COMPAT_NO_QUIT_VIDEO", SDL_FALSE)) {
+    if (GetHintConfig()->no_quit_video) {
         sdl12flags &= ~SDL12_INIT_VIDEO;
     }
     InitFlags12to20(sdl12flags, &sdl20flags, &extraflags);
@@ -3012,6 +3670,7 @@ SDL_QuitSubSystem(Uint32 sdl12flags)
 
     if (sdl12flags & SDL12_INIT_AUDIO) {
         SDL_CloseAudio();
+        FreeCVTStreamCache();
     }
 
     if (sdl12flags & SDL12_INIT_VIDEO) {
@@ -3035,9 +3694,10 @@ SDL_QuitSubSystem(Uint32 sdl12flags)
 DECLSPEC12 void SDLCALL
 SDL_Quit(void)
 {
-    SDL_bool noquitvideo = SDL12Compat_GetHintBoolean("SDL12COMPAT_NO_QUIT_VIDEO", SDL_FALSE);
+    SDL_bool noquitvideo = GetHintConfig()->no_quit_video;
     SDL_QuitSubSystem(SDL_WasInit(0) | SDL12_INIT_CDROM);
     SDL_assert((InitializedSubsystems20 == 0) || (noquitvideo && (InitializedSubsystems20 == SDL_INIT_VIDEO)));
+    FreeHintConfig();
 }
 
 DECLSPEC12 void SDLCALL
@@ -3073,10 +3733,12 @@ SDL_SetError(const char *fmt, ...)
 DECLSPEC12 const char * SDLCALL
 SDL_GetError(void)
 {
+    #ifndef SDL12COMPAT_DIRECT_SDL2
     if (SDL20_GetError == NULL) {
         static const char noload_errstr[] = "SDL2 library isn't loaded.";
         return noload_errstr;
     }
+    #endif
     return SDL20_GetError();
 }
 
@@ -5404,6 +6066,7 @@ Surface20to12InPlace(SDL_Surface *surface20,
                      SDL12_Surface *surface12)
 {
     SDL_BlendMode blendmode = SDL_BLENDMODE_NONE;
+    SurfaceFormat12 *wrapper = NULL;
     SDL12_Palette *palette12 = NULL;
     SDL12_PixelFormat *format12 = NULL;
     Uint32 flags = 0;
@@ -5416,26 +6079,18 @@ Surface20to12InPlace(SDL_Surface *surface20,
         return SDL_FALSE;
     }
 
-    if (surface20->format->palette) {
-        palette12 = (SDL12_Palette *) SDL20_malloc(sizeof (SDL12_Palette));
-        if (!palette12) {
-            goto failed;
-        }
-    }
-
-    format12 = (SDL12_PixelFormat *) SDL20_malloc(sizeof (SDL12_PixelFormat));
-    if (!format12) {
-        goto failed;
+    wrapper = (SurfaceFormat12 *) AllocWrapper(&FormatWrapperPool);  /* this zeroes the memory. */
+    if (!wrapper) {
+        return SDL_FALSE;
     }
 
-    if (palette12) {
-        SDL20_zerop(palette12);
-        SDL_assert(surface20->format->palette);
+    format12 = &wrapper->format;
+    if (surface20->format->palette) {
+        palette12 = &wrapper->palette;
         palette12->ncolors = surface20->format->palette->ncolors;
         palette12->colors = surface20->format->palette->colors;
     }
 
-    SDL20_zerop(format12);
     format12->palette = palette12;
     format12->BitsPerPixel = surface20->format->BitsPerPixel;
     format12->BytesPerPixel = surface20->format->BytesPerPixel;
@@ -5487,33 +6142,22 @@ Surface20to12InPlace(SDL_Surface *surface20,
     surface12->refcount = surface20->refcount;
 
     return SDL_TRUE;
-
-failed:
-    SDL20_free(palette12);
-    SDL20_free(format12);
-    return SDL_FALSE;
 }
 
 static SDL12_Surface *
 Surface20to12(SDL_Surface *surface20)
 {
-    SDL12_Surface *surface12 = NULL;
-
-    surface12 = (SDL12_Surface *) SDL20_malloc(sizeof (SDL12_Surface));
+    SDL12_Surface *surface12 = (SDL12_Surface *) AllocWrapper(&SurfaceWrapperPool);  /* this zeroes the memory. */
     if (!surface12) {
-        goto failed;
+        return NULL;
     }
 
-    SDL20_zerop(surface12);
     if (!Surface20to12InPlace(surface20, surface12)) {
-        goto failed;
+        FreeWrapper(&SurfaceWrapperPool, surface12);
+        return NULL;
     }
 
     return surface12;
-
-failed:
-    SDL20_free(surface12);
-    return NULL;
 }
 
 static void
@@ -5580,6 +6224,39 @@ SetPalette12ForMasks(SDL12_Surface *surface12, const Uint32 Rmask, const Uint32
     }
 }
 
+/* If we're padding rows, we allocate the pixels and hand them to SDL2 as
+   if the app had. The 1.2 surface doesn't get SDL12_PREALLOC, which is how
+   FreeSurfaceContents knows they're ours to free. */
+static SDL_Surface *
+CreateRGBSurface20(int width, int height, int depth, Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask)
+{
+    const int bpp = (depth + 7) / 8;
+    SDL_Surface *surface20;
+    void *pixels;
+    int pitch;
+
+    if ((depth < 8) || (width <= 0) || (height <= 0)) {
+        return SDL20_CreateRGBSurface(0, width, height, depth, Rmask, Gmask, Bmask, Amask);
+    }
+
+    pitch = SurfacePitch12(width, bpp);
+    if (pitch == (width * bpp)) {  /* not padding it? Just let SDL2 do it. */
+        return SDL20_CreateRGBSurface(0, width, height, depth, Rmask, Gmask, Bmask, Amask);
+    }
+
+    pixels = AllocSurfacePixels(((size_t) height) * ((size_t) pitch));
+    if (!pixels) {
+        SDL20_OutOfMemory();
+        return NULL;
+    }
+
+    surface20 = SDL20_CreateRGBSurfaceFrom(pixels, width, height, depth, pitch, Rmask, Gmask, Bmask, Amask);
+    if (!surface20) {
+        FreeSurfacePixels(pixels);
+    }
+    return surface20;
+}
+
 static SDL_Surface *
 CreateRGBSurface(Uint32 flags12, int width, int height, int depth, Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask)
 {
@@ -5604,9 +6281,9 @@ CreateRGBSurface(Uint32 flags12, int width, int height, int depth, Uint32 Rmask,
     }
 
     if (depth <= 8) {  /* don't pass masks to SDL2 for <= 8-bit surfaces, it'll cause problems. */
-        surface20 = SDL20_CreateRGBSurface(0, width, height, depth, 0, 0, 0, 0);
+        surface20 = CreateRGBSurface20(width, height, depth, 0, 0, 0, 0);
     } else {
-        surface20 = SDL20_CreateRGBSurface(0, width, height, depth, Rmask, Gmask, Bmask, Amask);
+        surface20 = CreateRGBSurface20(width, height, depth, Rmask, Gmask, Bmask, Amask);
     }
 
     /* SDL 1.2 would make a surface from almost any masks, even if it doesn't
@@ -5628,7 +6305,7 @@ CreateRGBSurface(Uint32 flags12, int width, int height, int depth, Uint32 Rmask,
             Bmask = SDL_SwapLE32(0x00FF0000);
             Amask = SDL_SwapLE32(Amask ? 0xFF000000 : 0x00000000);
         }
-        surface20 = SDL20_CreateRGBSurface(0, width, height, depth, Rmask, Gmask, Bmask, Amask);
+        surface20 = CreateRGBSurface20(width, height, depth, Rmask, Gmask, Bmask, Amask);
     }
 
     return surface20;
@@ -5657,12 +6334,18 @@ SDL_CreateRGBSurface(Uint32 flags12, int width, int height, int depth, Uint32 Rm
     }
     surface12 = Surface20to12(surface20);
     if (!surface12) {
+        void *ownedpixels = (surface20->flags & SDL_PREALLOC) ? surface20->pixels : NULL;
         SDL20_FreeSurface(surface20);
+        FreeSurfacePixels(ownedpixels);
         return NULL;
     }
 
+    surface12->flags &= ~SDL12_PREALLOC;  /* if SDL2 thinks it's preallocated, that's our allocation, not the app's. */
     SDL_assert(!(width && height) || ((surface12->flags & ~(SDL12_SRCCOLORKEY|SDL12_SRCALPHA))) == 0);  /* shouldn't have prealloc, rleaccel, or dontfree. */
     Surface12SetMasks(surface12, Rmask, Gmask, Bmask, Amask);
+    if (flags12 & SDL12_HWSURFACE) {
+        MarkHardwareSurface(surface12);
+    }
     return surface12;
 }
 
@@ -5706,7 +6389,7 @@ SDL_FreeSurface(SDL12_Surface *surface12)
         if (surface12->refcount)
             return;
         FreeSurfaceContents(surface12);
-        SDL20_free(surface12);
+        FreeWrapper(&SurfaceWrapperPool, surface12);
     }
 }
 
@@ -5731,55 +6414,771 @@ SDL_SetClipRect(SDL12_Surface *surface12, const SDL12_Rect *rect12)
     return retval;
 }
 
-DECLSPEC12 int SDLCALL
-SDL_FillRect(SDL12_Surface *dst, SDL12_Rect *dstrect12, Uint32 color)
+/* Optionally, big fills and stretches get split into horizontal bands, and
+   worker threads each do a band. Each fill band is a rectangle that's
+   already been clipped to the surface's clip rect and is handed to SDL2, and
+   each stretch band is a run of destination rows that we scale ourselves
+   (see StretchRows), so the result is the same as doing it in one
+   piece; the only difference is how many CPUs touch it.
+   Anything below BAND_MIN_PIXELS runs inline, since waking the workers
+   costs more than a small fill.
+
+   Blits are NOT banded: SDL2's SDL_SoftBlit stores each call's pixel
+   pointers and sizes in the source surface's shared blit map, so two
+   threads blitting from the same surface at once would stomp on each
+   other. SDL_FillRect has no shared state like that. */
+#define MAX_BAND_THREADS 16
+#define BAND_MIN_PIXELS (256 * 256)
+
+struct StretchJob;
+static void StretchRows(const struct StretchJob *job, const int y1, const int y2);
+
+typedef enum
 {
-    SDL_Rect dstrect20;
-    const int retval = SDL20_FillRect(dst->surface20, dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL, color);
-    if (retval == 0) {
-        if (dstrect12) {  /* 1.2 stores the clip intersection in dstrect */
-            SDL_Rect intersected20;
-            SDL20_IntersectRect(&dstrect20, &dst->surface20->clip_rect, &intersected20);
-            Rect20to12(&intersected20, dstrect12);
-        }
-    }
-    return retval;
-}
+    BANDJOB_FILL,
+    BANDJOB_STRETCH
+} BandJobType;
 
-DECLSPEC12 Uint32 SDLCALL
-SDL_MapRGB(const SDL12_PixelFormat *format12, Uint8 r, Uint8 g, Uint8 b)
+typedef struct BandJob
 {
-    /* This is probably way slower than apps expect. */
-    SDL_PixelFormat format20;
-    SDL_Palette palette20;
-    return SDL20_MapRGB(PixelFormat12to20(&format20, &palette20, format12), r, g, b);
-}
+    BandJobType type;
+    SDL_Surface *dst;
+    SDL_Rect dstrect;  /* for stretches, the rows are relative to the stretch's dstrect. */
+    Uint32 color;  /* fills only. */
+    const struct StretchJob *stretch;  /* stretches only. */
+    int retval;
+} BandJob;
+
+static SDL_Thread *BandWorkers[MAX_BAND_THREADS];
+static int NumBandWorkers = 0;
+static SDL_sem *BandWorkSem = NULL;
+static SDL_sem *BandDoneSem = NULL;
+static BandJob BandJobs[MAX_BAND_THREADS + 1];
+static SDL_atomic_t BandNextJob;
+static SDL_atomic_t BandWorkersBusy;
+static SDL_bool BandWorkersQuit = SDL_FALSE;
+
+static void
+RunBandJob(BandJob *job)
+{
+    switch (job->type) {
+        case BANDJOB_FILL:
+            job->retval = SDL20_FillRect(job->dst, &job->dstrect, job->color);
+            break;
+        case BANDJOB_STRETCH:
+            StretchRows(job->stretch, job->dstrect.y, job->dstrect.y + job->dstrect.h);
+            job->retval = 0;
+            break;
+    }
+}
+
+static int SDLCALL
+BandWorkerThread(void *data)
+{
+    (void) data;
+    for (;;) {
+        SDL20_SemWait(BandWorkSem);
+        if (BandWorkersQuit) {
+            break;
+        }
+        RunBandJob(&BandJobs[SDL20_AtomicAdd(&BandNextJob, 1)]);
+        SDL20_SemPost(BandDoneSem);
+    }
+    return 0;
+}
+
+static void
+QuitBandWorkers(void)
+{
+    int i;
+
+    if (NumBandWorkers) {
+        BandWorkersQuit = SDL_TRUE;
+        for (i = 0; i < NumBandWorkers; i++) {
+            SDL20_SemPost(BandWorkSem);
+        }
+        for (i = 0; i < NumBandWorkers; i++) {
+            SDL20_WaitThread(BandWorkers[i], NULL);
+            BandWorkers[i] = NULL;
+        }
+        NumBandWorkers = 0;
+        BandWorkersQuit = SDL_FALSE;
+    }
+
+    if (BandWorkSem) {
+        SDL20_DestroySemaphore(BandWorkSem);
+        BandWorkSem = NULL;
+    }
+    if (BandDoneSem) {
+        SDL20_DestroySemaphore(BandDoneSem);
+        BandDoneSem = NULL;
+    }
+}
+
+/* Call with BandWorkersBusy held. */
+static SDL_bool
+StartBandWorkers(void)
+{
+    const int total = SDL_min(BandThreadCount, MAX_BAND_THREADS + 1);
+
+    if (NumBandWorkers) {
+        return SDL_TRUE;
+    } else if (total < 2) {
+        return SDL_FALSE;
+    }
+
+    BandWorkSem = SDL20_CreateSemaphore(0);
+    BandDoneSem = SDL20_CreateSemaphore(0);
+    if (!BandWorkSem || !BandDoneSem) {
+        QuitBandWorkers();
+        return SDL_FALSE;
+    }
+
+    /* the calling thread does a band too, so we need one less worker than the total. */
+    while (NumBandWorkers < (total - 1)) {
+        #ifdef SDL_PASSED_BEGINTHREAD_ENDTHREAD
+        SDL_Thread *thread = SDL20_CreateThread(BandWorkerThread, "SDL12 band worker", NULL, NULL, NULL);
+        #else
+        SDL_Thread *thread = SDL20_CreateThread(BandWorkerThread, "SDL12 band worker", NULL);
+        #endif
+        if (!thread) {
+            break;
+        }
+        BandWorkers[NumBandWorkers++] = thread;
+    }
+
+    if (WantDebugLogging) {
+        SDL20_Log("Started %d band worker threads for fills and stretches", NumBandWorkers);
+    }
+
+    if (!NumBandWorkers) {
+        QuitBandWorkers();
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+/* Returns SDL_FALSE if the workers can't be had right now; do it inline.
+   Otherwise, call ReleaseBandWorkers when done with them. */
+static SDL_bool
+GrabBandWorkers(void)
+{
+    if (BandThreadCount < 2) {
+        return SDL_FALSE;
+    } else if (!SDL20_AtomicCAS(&BandWorkersBusy, 0, 1)) {
+        return SDL_FALSE;  /* another thread is using the workers right now; just do it inline. */
+    } else if (!StartBandWorkers()) {
+        SDL20_AtomicSet(&BandWorkersBusy, 0);
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+static void
+ReleaseBandWorkers(void)
+{
+    SDL20_AtomicSet(&BandWorkersBusy, 0);
+}
+
+/* Call with the workers grabbed, once BandJobs[0] through BandJobs[bands - 1]
+   are set up. The calling thread does the first one. Returns a band's
+   failure, if any; if the first band fails, the rest aren't run at all. */
+static int
+RunBandJobs(const int bands)
+{
+    int retval, i;
+
+    RunBandJob(&BandJobs[0]);
+
+    retval = BandJobs[0].retval;
+    if (retval == 0) {
+        SDL20_AtomicSet(&BandNextJob, 1);
+        for (i = 1; i < bands; i++) {
+            SDL20_SemPost(BandWorkSem);
+        }
+        for (i = 1; i < bands; i++) {
+            SDL20_SemWait(BandDoneSem);
+        }
+        for (i = 1; i < bands; i++) {
+            if (BandJobs[i].retval < 0) {
+                retval = BandJobs[i].retval;
+            }
+        }
+    }
+    return retval;
+}
+
+/* Returns SDL_FALSE if this should just be done inline, in which case
+   nothing was done. Otherwise, *retval has the result. rect must already be
+   clipped to the destination surface's clip rect. */
+static SDL_bool
+RunBandedFill(SDL_Surface *dst, const SDL_Rect *rect, Uint32 color, int *retval)
+{
+    int i, bands;
+
+    if ((BandThreadCount < 2) || ((rect->w * rect->h) < BAND_MIN_PIXELS)) {
+        return SDL_FALSE;
+    } else if (SDL_MUSTLOCK(dst) || dst->locked) {
+        return SDL_FALSE;  /* let SDL2 deal with locking and RLE, one thread at a time. */
+    } else if (!GrabBandWorkers()) {
+        return SDL_FALSE;
+    }
+
+    bands = SDL_min(NumBandWorkers + 1, rect->h);
+    for (i = 0; i < bands; i++) {
+        BandJob *job = &BandJobs[i];
+        const int y1 = (rect->h * i) / bands;
+        const int y2 = (rect->h * (i + 1)) / bands;
+        job->type = BANDJOB_FILL;
+        job->dst = dst;
+        job->color = color;
+        job->dstrect.x = rect->x;
+        job->dstrect.y = rect->y + y1;
+        job->dstrect.w = rect->w;
+        job->dstrect.h = y2 - y1;
+    }
+
+    *retval = RunBandJobs(bands);
+
+    ReleaseBandWorkers();
+    return SDL_TRUE;
+}
+
+/* This is SDL2's SDL_UpperBlit clipping, so we can hand the result to
+   the GPU. Returns SDL_FALSE if nothing would be
+   drawn. srcrect and dstrect can be NULL, like SDL_UpperBlit. */
+static SDL_bool
+ClipUpperBlit(SDL_Surface *src, const SDL_Rect *srcrect, SDL_Surface *dst, const SDL_Rect *dstrect, SDL_Rect *sr, SDL_Rect *dr)
+{
+    const SDL_Rect *clip = &dst->clip_rect;
+    int srcx, srcy, w, h, dx, dy;
+
+    if (dstrect) {
+        dr->x = dstrect->x;
+        dr->y = dstrect->y;
+    } else {
+        dr->x = dr->y = 0;
+    }
+
+    if (srcrect) {
+        srcx = srcrect->x;
+        w = srcrect->w;
+        if (srcx < 0) {
+            w += srcx;
+            dr->x -= srcx;
+            srcx = 0;
+        }
+        w = SDL_min(w, src->w - srcx);
+
+        srcy = srcrect->y;
+        h = srcrect->h;
+        if (srcy < 0) {
+            h += srcy;
+            dr->y -= srcy;
+            srcy = 0;
+        }
+        h = SDL_min(h, src->h - srcy);
+    } else {
+        srcx = srcy = 0;
+        w = src->w;
+        h = src->h;
+    }
+
+    dx = clip->x - dr->x;
+    if (dx > 0) {
+        w -= dx;
+        dr->x += dx;
+        srcx += dx;
+    }
+    dx = dr->x + w - clip->x - clip->w;
+    if (dx > 0) {
+        w -= dx;
+    }
+
+    dy = clip->y - dr->y;
+    if (dy > 0) {
+        h -= dy;
+        dr->y += dy;
+        srcy += dy;
+    }
+    dy = dr->y + h - clip->y - clip->h;
+    if (dy > 0) {
+        h -= dy;
+    }
+
+    if ((w <= 0) || (h <= 0)) {
+        return SDL_FALSE;
+    }
+
+    sr->x = srcx;
+    sr->y = srcy;
+    sr->w = dr->w = w;
+    sr->h = dr->h = h;
+    return SDL_TRUE;
+}
+
+/* SDL2 builds a color map for blits from an 8-bit surface, and throws it
+   away whenever either palette's version changes. Lots of 1.2 games call
+   SDL_SetColors on their sprite sheets every frame, flipping between a
+   handful of palettes for team colors or flashing effects, so SDL2 ends
+   up rebuilding the map over and over. We do these simple blits ourselves
+   instead, with a small cache of maps keyed on the actual palette contents,
+   so going back to a palette we've seen recently is just a lookup.
+
+   We only take blits that are a straight table lookup in SDL2 (no blending,
+   no RLE, 8-bit source to an 8, 16 or 32-bit destination) and build the
+   maps exactly like SDL2 does, so the results are the same. */
+#define PALETTE_MAP_CACHE_SIZE 16
+
+typedef struct PaletteMapCacheEntry
+{
+    Uint32 hash;
+    Uint32 lastused;
+    /* the last palettes that matched this entry, so we can skip hashing when they haven't changed. */
+    const SDL_Palette *srcpal;
+    Uint32 srcversion;
+    const SDL_Palette *dstpal;
+    Uint32 dstversion;
+    int srcncolors;
+    int dstncolors;  /* zero if the destination isn't paletted. */
+    Uint32 dstmasks[4];
+    Uint8 dstbpp;
+    SDL_bool identity;
+    SDL_Color srccolors[256];
+    SDL_Color dstcolors[256];
+    Uint32 map[256];
+} PaletteMapCacheEntry;
+
+static PaletteMapCacheEntry *PaletteMapCache[PALETTE_MAP_CACHE_SIZE];
+static SDL_SpinLock PaletteMapCacheLock = 0;
+static Uint32 PaletteMapCacheTicks = 0;
+static Uint32 PaletteMapCacheHits = 0;
+static Uint32 PaletteMapCacheContentHits = 0;
+static Uint32 PaletteMapCacheMisses = 0;
+
+static Uint32
+HashPaletteMapKey(const SDL_Palette *srcpal, const SDL_PixelFormat *dstfmt)
+{
+    Uint32 hash = 2166136261u;  /* FNV-1a */
+    const Uint8 *ptr = (const Uint8 *) srcpal->colors;
+    int len = srcpal->ncolors * (int) sizeof (SDL_Color);
+    int i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ ptr[i]) * 16777619u;
+    }
+
+    if (dstfmt->palette) {
+        ptr = (const Uint8 *) dstfmt->palette->colors;
+        len = dstfmt->palette->ncolors * (int) sizeof (SDL_Color);
+        for (i = 0; i < len; i++) {
+            hash = (hash ^ ptr[i]) * 16777619u;
+        }
+    } else {
+        hash = (hash ^ dstfmt->Rmask) * 16777619u;
+        hash = (hash ^ dstfmt->Gmask) * 16777619u;
+        hash = (hash ^ dstfmt->Bmask) * 16777619u;
+        hash = (hash ^ dstfmt->Amask) * 16777619u;
+    }
+    return hash ^ dstfmt->BytesPerPixel;
+}
+
+static SDL_bool
+PaletteMapEntryMatches(const PaletteMapCacheEntry *entry, const SDL_Palette *srcpal, const SDL_PixelFormat *dstfmt)
+{
+    const SDL_Palette *dstpal = dstfmt->palette;
+    if ((entry->srcncolors != srcpal->ncolors) || (entry->dstbpp != dstfmt->BytesPerPixel)) {
+        return SDL_FALSE;
+    } else if (SDL20_memcmp(entry->srccolors, srcpal->colors, srcpal->ncolors * sizeof (SDL_Color)) != 0) {
+        return SDL_FALSE;
+    } else if (dstpal) {
+        return ((entry->dstncolors == dstpal->ncolors) && (SDL20_memcmp(entry->dstcolors, dstpal->colors, dstpal->ncolors * sizeof (SDL_Color)) == 0)) ? SDL_TRUE : SDL_FALSE;
+    }
+    return ((entry->dstncolors == 0) &&
+            (entry->dstmasks[0] == dstfmt->Rmask) && (entry->dstmasks[1] == dstfmt->Gmask) &&
+            (entry->dstmasks[2] == dstfmt->Bmask) && (entry->dstmasks[3] == dstfmt->Amask)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* This is SDL2's SDL_FindColor. */
+static Uint8
+FindPaletteColor(const SDL_Palette *pal, const SDL_Color *color)
+{
+    unsigned int smallest = ~0u;
+    Uint8 pixel = 0;
+    int i;
+
+    for (i = 0; i < pal->ncolors; i++) {
+        const int rd = pal->colors[i].r - color->r;
+        const int gd = pal->colors[i].g - color->g;
+        const int bd = pal->colors[i].b - color->b;
+        const int ad = pal->colors[i].a - color->a;
+        const unsigned int distance = (unsigned int) ((rd * rd) + (gd * gd) + (bd * bd) + (ad * ad));
+        if (distance < smallest) {
+            pixel = (Uint8) i;
+            if (distance == 0) {
+                break;  /* perfect match! */
+            }
+            smallest = distance;
+        }
+    }
+    return pixel;
+}
+
+/* This is SDL2's Map1to1 and Map1toN. */
+static void
+BuildPaletteMap(PaletteMapCacheEntry *entry, const SDL_Palette *srcpal, const SDL_PixelFormat *dstfmt)
+{
+    const SDL_Palette *dstpal = dstfmt->palette;
+    int i;
+
+    SDL20_memset(entry->map, '\0', sizeof (entry->map));
+    entry->srcncolors = srcpal->ncolors;
+    SDL20_memcpy(entry->srccolors, srcpal->colors, srcpal->ncolors * sizeof (SDL_Color));
+    entry->dstbpp = dstfmt->BytesPerPixel;
+    entry->dstmasks[0] = dstfmt->Rmask;
+    entry->dstmasks[1] = dstfmt->Gmask;
+    entry->dstmasks[2] = dstfmt->Bmask;
+    entry->dstmasks[3] = dstfmt->Amask;
+    entry->identity = SDL_FALSE;
+
+    if (dstpal) {
+        entry->dstncolors = dstpal->ncolors;
+        SDL20_memcpy(entry->dstcolors, dstpal->colors, dstpal->ncolors * sizeof (SDL_Color));
+        if ((srcpal->ncolors <= dstpal->ncolors) && (SDL20_memcmp(srcpal->colors, dstpal->colors, srcpal->ncolors * sizeof (SDL_Color)) == 0)) {
+            entry->identity = SDL_TRUE;
+        } else {
+            for (i = 0; i < srcpal->ncolors; i++) {
+                entry->map[i] = FindPaletteColor(dstpal, &srcpal->colors[i]);
+            }
+        }
+    } else {
+        entry->dstncolors = 0;
+        for (i = 0; i < srcpal->ncolors; i++) {
+            const SDL_Color *c = &srcpal->colors[i];
+            entry->map[i] = ((((Uint32) c->r) >> dstfmt->Rloss) << dstfmt->Rshift) |
+                            ((((Uint32) c->g) >> dstfmt->Gloss) << dstfmt->Gshift) |
+                            ((((Uint32) c->b) >> dstfmt->Bloss) << dstfmt->Bshift) |
+                            (((((Uint32) c->a) >> dstfmt->Aloss) << dstfmt->Ashift) & dstfmt->Amask);
+        }
+    }
+}
+
+/* Copies the right map into `map`; returns SDL_FALSE if it's an identity
+   map (so the pixels can be copied as-is), or if we couldn't make one. */
+static SDL_bool
+GetPaletteMap(const SDL_Palette *srcpal, const SDL_PixelFormat *dstfmt, Uint32 *map, SDL_bool *identity)
+{
+    const SDL_Palette *dstpal = dstfmt->palette;
+    const Uint32 dstversion = dstpal ? dstpal->version : 0;
+    PaletteMapCacheEntry *entry = NULL;
+    Uint32 hash;
+    int i;
+
+    SDL20_AtomicLock(&PaletteMapCacheLock);
+
+    PaletteMapCacheTicks++;
+
+    for (i = 0; i < PALETTE_MAP_CACHE_SIZE; i++) {
+        PaletteMapCacheEntry *e = PaletteMapCache[i];
+        if (e && (e->srcpal == srcpal) && (e->srcversion == srcpal->version) &&
+            (e->dstpal == dstpal) && (e->dstversion == dstversion) &&
+            (dstpal || ((e->dstbpp == dstfmt->BytesPerPixel) && (e->dstmasks[0] == dstfmt->Rmask) &&
+                        (e->dstmasks[1] == dstfmt->Gmask) && (e->dstmasks[2] == dstfmt->Bmask) &&
+                        (e->dstmasks[3] == dstfmt->Amask)))) {
+            entry = e;
+            PaletteMapCacheHits++;
+            break;
+        }
+    }
+
+    if (!entry) {
+        int victim = 0;
+        hash = HashPaletteMapKey(srcpal, dstfmt);
+        for (i = 0; i < PALETTE_MAP_CACHE_SIZE; i++) {
+            PaletteMapCacheEntry *e = PaletteMapCache[i];
+            if (!e) {
+                victim = i;
+                break;
+            } else if ((e->hash == hash) && PaletteMapEntryMatches(e, srcpal, dstfmt)) {
+                entry = e;
+                PaletteMapCacheHits++;
+                PaletteMapCacheContentHits++;
+                break;
+            } else if (e->lastused < PaletteMapCache[victim]->lastused) {
+                victim = i;
+            }
+        }
+
+        if (!entry) {
+            entry = PaletteMapCache[victim];
+            if (!entry) {
+                entry = (PaletteMapCacheEntry *) SDL20_malloc(sizeof (PaletteMapCacheEntry));
+                if (!entry) {
+                    SDL20_AtomicUnlock(&PaletteMapCacheLock);
+                    return SDL_FALSE;  /* let SDL2 deal with it. */
+                }
+                PaletteMapCache[victim] = entry;
+            }
+            PaletteMapCacheMisses++;
+            entry->hash = hash;
+            BuildPaletteMap(entry, srcpal, dstfmt);
+        }
+
+        entry->srcpal = srcpal;
+        entry->dstpal = dstpal;
+    }
+
+    entry->srcversion = srcpal->version;
+    entry->dstversion = dstversion;
+    entry->lastused = PaletteMapCacheTicks;
+    *identity = entry->identity;
+    if (!entry->identity) {
+        SDL20_memcpy(map, entry->map, sizeof (entry->map));
+    }
+
+    SDL20_AtomicUnlock(&PaletteMapCacheLock);
+    return SDL_TRUE;
+}
+
+/* A palette is going away; make sure a new one at the same address can't look like it. */
+static void
+ForgetPaletteMaps(const SDL_Palette *palette)
+{
+    int i;
+    if (!palette) {
+        return;
+    }
+    SDL20_AtomicLock(&PaletteMapCacheLock);
+    for (i = 0; i < PALETTE_MAP_CACHE_SIZE; i++) {
+        PaletteMapCacheEntry *e = PaletteMapCache[i];
+        if (e && ((e->srcpal == palette) || (e->dstpal == palette))) {
+            e->srcpal = e->dstpal = NULL;
+        }
+    }
+    SDL20_AtomicUnlock(&PaletteMapCacheLock);
+}
+
+static void
+FreePaletteMapCache(void)
+{
+    int i;
+    SDL20_AtomicLock(&PaletteMapCacheLock);
+    if (WantDebugLogging && (PaletteMapCacheHits || PaletteMapCacheMisses)) {
+        SDL20_Log("Palette map cache: %u hits (%u after a palette change), %u misses",
+                  (unsigned int) PaletteMapCacheHits, (unsigned int) PaletteMapCacheContentHits,
+                  (unsigned int) PaletteMapCacheMisses);
+    }
+    for (i = 0; i < PALETTE_MAP_CACHE_SIZE; i++) {
+        SDL20_free(PaletteMapCache[i]);
+        PaletteMapCache[i] = NULL;
+    }
+    PaletteMapCacheTicks = PaletteMapCacheHits = PaletteMapCacheContentHits = PaletteMapCacheMisses = 0;
+    SDL20_AtomicUnlock(&PaletteMapCacheLock);
+}
+
+/* srcrect and dstrect are already clipped, like SDL_LowerBlit wants.
+   Returns SDL_FALSE if SDL2 should do this one. */
+static SDL_bool
+PaletteMapLowerBlit(SDL_Surface *src, const SDL_Rect *srcrect, SDL_Surface *dst, const SDL_Rect *dstrect)
+{
+    const SDL_PixelFormat *dstfmt = dst->format;
+    const int dstbpp = dstfmt->BytesPerPixel;
+    const int w = dstrect->w;
+    int h = dstrect->h;
+    SDL_BlendMode blendmode = SDL_BLENDMODE_NONE;
+    Uint8 alphamod = 255;
+    SDL_bool identity = SDL_FALSE;
+    SDL_bool haskey;
+    Uint32 colorkey = 0;
+    Uint32 map[256];
+    const Uint8 *srcrow;
+    Uint8 *dstrow;
+    int x;
+
+    if (!src->format->palette || (src->format->BytesPerPixel != 1) || (src->format->BitsPerPixel != 8)) {
+        return SDL_FALSE;
+    } else if ((dstbpp != 1) && (dstbpp != 2) && (dstbpp != 4)) {
+        return SDL_FALSE;
+    } else if ((dstbpp == 1) && ((dstfmt->BitsPerPixel != 8) || !dstfmt->palette)) {
+        return SDL_FALSE;
+    } else if ((src->flags & SDL_RLEACCEL) || src->locked || dst->locked) {
+        return SDL_FALSE;  /* RLE has its own blitters, and SDL2 reports the locked error. */
+    } else if ((SDL20_GetSurfaceBlendMode(src, &blendmode) < 0) || (blendmode != SDL_BLENDMODE_NONE)) {
+        return SDL_FALSE;
+    } else if ((SDL20_GetSurfaceAlphaMod(src, &alphamod) < 0) || (alphamod != 255)) {
+        return SDL_FALSE;
+    } else if (!GetPaletteMap(src->format->palette, dstfmt, map, &identity)) {
+        return SDL_FALSE;
+    }
+
+    haskey = (SDL20_GetColorKey(src, &colorkey) == 0) ? SDL_TRUE : SDL_FALSE;
+
+    srcrow = ((const Uint8 *) src->pixels) + (srcrect->y * src->pitch) + srcrect->x;
+    dstrow = ((Uint8 *) dst->pixels) + (dstrect->y * dst->pitch) + (dstrect->x * dstbpp);
+
+    while (h--) {
+        const Uint8 *s = srcrow;
+        if (dstbpp == 1) {
+            Uint8 *d = dstrow;
+            if (identity && !haskey) {
+                SDL20_memcpy(d, s, w);
+            } else if (identity) {
+                for (x = 0; x < w; x++) {
+                    if (s[x] != colorkey) {
+                        d[x] = s[x];
+                    }
+                }
+            } else if (!haskey) {
+                for (x = 0; x < w; x++) {
+                    d[x] = (Uint8) map[s[x]];
+                }
+            } else {
+                for (x = 0; x < w; x++) {
+                    if (s[x] != colorkey) {
+                        d[x] = (Uint8) map[s[x]];
+                    }
+                }
+            }
+        } else if (dstbpp == 2) {
+            Uint16 *d = (Uint16 *) dstrow;
+            for (x = 0; x < w; x++) {
+                if (!haskey || (s[x] != colorkey)) {
+                    d[x] = (Uint16) map[s[x]];
+                }
+            }
+        } else {
+            Uint32 *d = (Uint32 *) dstrow;
+            for (x = 0; x < w; x++) {
+                if (!haskey || (s[x] != colorkey)) {
+                    d[x] = map[s[x]];
+                }
+            }
+        }
+        srcrow += src->pitch;
+        dstrow += dst->pitch;
+    }
+
+    return SDL_TRUE;
+}
+
+/* Returns SDL_FALSE if this should just go to SDL20_UpperBlit. */
+static SDL_bool
+PaletteMapUpperBlit(SDL_Surface *src, const SDL_Rect *srcrect, SDL_Surface *dst, SDL_Rect *dstrect, int *retval)
+{
+    SDL_Rect sr, dr;
+
+    if (!src->format->palette) {
+        return SDL_FALSE;  /* the common case, get out quickly. */
+    } else if (!ClipUpperBlit(src, srcrect, dst, dstrect, &sr, &dr)) {
+        return SDL_FALSE;  /* SDL2 will figure out the empty blit. */
+    } else if (!PaletteMapLowerBlit(src, &sr, dst, &dr)) {
+        return SDL_FALSE;
+    }
+
+    *retval = 0;
+    if (dstrect) {
+        SDL20_memcpy(dstrect, &dr, sizeof (SDL_Rect));
+    }
+    return SDL_TRUE;
+}
+
+DECLSPEC12 int SDLCALL
+SDL_FillRect(SDL12_Surface *dst, SDL12_Rect *dstrect12, Uint32 color)
+{
+    SDL_Rect dstrect20;
+    int retval;
+
+    SurfaceWillChange12(dst);
+
+    if (BandThreadCount >= 2) {
+        SDL_Rect clipped20;
+        if (dstrect12) {
+            Rect12to20(dstrect12, &dstrect20);
+        } else {
+            dstrect20.x = dstrect20.y = 0;
+            dstrect20.w = dst->surface20->w;
+            dstrect20.h = dst->surface20->h;
+        }
+        if (SDL20_IntersectRect(&dstrect20, &dst->surface20->clip_rect, &clipped20) &&
+            RunBandedFill(dst->surface20, &clipped20, color, &retval)) {
+            if ((retval == 0) && dstrect12) {  /* 1.2 stores the clip intersection in dstrect */
+                Rect20to12(&clipped20, dstrect12);
+            }
+            return retval;
+        }
+    }
+
+    retval = SDL20_FillRect(dst->surface20, dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL, color);
+    if (retval == 0) {
+        if (dstrect12) {  /* 1.2 stores the clip intersection in dstrect */
+            SDL_Rect intersected20;
+            SDL20_IntersectRect(&dstrect20, &dst->surface20->clip_rect, &intersected20);
+            Rect20to12(&intersected20, dstrect12);
+        }
+    }
+    return retval;
+}
+
+/* Apps call these per-pixel or per-particle, so packed formats are handled
+   right here, with the same math SDL2 uses. Paletted formats still go to SDL2
+   to search the palette, and we don't duplicate SDL2's expansion tables for
+   GetRGB on formats with less than 8 bits per channel. The 1.2 format has
+   everything we need, so we never have to build a complete SDL2 format. */
+DECLSPEC12 Uint32 SDLCALL
+SDL_MapRGB(const SDL12_PixelFormat *format12, Uint8 r, Uint8 g, Uint8 b)
+{
+    SDL_PixelFormat format20;
+    SDL_Palette palette20;
+    if (!format12->palette) {
+        return ((Uint32) (r >> format12->Rloss) << format12->Rshift) |
+               ((Uint32) (g >> format12->Gloss) << format12->Gshift) |
+               ((Uint32) (b >> format12->Bloss) << format12->Bshift) |
+               format12->Amask;
+    }
+    return SDL20_MapRGB(PixelFormat12to20NoEnum(&format20, &palette20, format12), r, g, b);
+}
 
 DECLSPEC12 Uint32 SDLCALL
 SDL_MapRGBA(const SDL12_PixelFormat *format12, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
-    /* This is probably way slower than apps expect. */
     SDL_PixelFormat format20;
     SDL_Palette palette20;
-    return SDL20_MapRGBA(PixelFormat12to20(&format20, &palette20, format12), r, g, b, a);
+    if (!format12->palette) {
+        return ((Uint32) (r >> format12->Rloss) << format12->Rshift) |
+               ((Uint32) (g >> format12->Gloss) << format12->Gshift) |
+               ((Uint32) (b >> format12->Bloss) << format12->Bshift) |
+               (((Uint32) (a >> format12->Aloss) << format12->Ashift) & format12->Amask);
+    }
+    return SDL20_MapRGBA(PixelFormat12to20NoEnum(&format20, &palette20, format12), r, g, b, a);
 }
 
 DECLSPEC12 void SDLCALL
 SDL_GetRGB(Uint32 pixel, const SDL12_PixelFormat *format12, Uint8 *r, Uint8 *g, Uint8 *b)
 {
-    /* This is probably way slower than apps expect. */
     SDL_PixelFormat format20;
     SDL_Palette palette20;
-    SDL20_GetRGB(pixel, PixelFormat12to20(&format20, &palette20, format12), r, g, b);
+    if (!format12->palette && !format12->Rloss && !format12->Gloss && !format12->Bloss) {
+        *r = (Uint8) ((pixel & format12->Rmask) >> format12->Rshift);
+        *g = (Uint8) ((pixel & format12->Gmask) >> format12->Gshift);
+        *b = (Uint8) ((pixel & format12->Bmask) >> format12->Bshift);
+        return;
+    }
+    SDL20_GetRGB(pixel, PixelFormat12to20NoEnum(&format20, &palette20, format12), r, g, b);
 }
 
 DECLSPEC12 void SDLCALL
 SDL_GetRGBA(Uint32 pixel, const SDL12_PixelFormat *format12, Uint8 *r, Uint8 *g, Uint8 *b, Uint8 *a)
 {
-    /* This is probably way slower than apps expect. */
     SDL_PixelFormat format20;
     SDL_Palette palette20;
-    SDL20_GetRGBA(pixel, PixelFormat12to20(&format20, &palette20, format12), r, g, b, a);
+    if (!format12->palette && !format12->Rloss && !format12->Gloss && !format12->Bloss && (!format12->Amask || !format12->Aloss)) {
+        *r = (Uint8) ((pixel & format12->Rmask) >> format12->Rshift);
+        *g = (Uint8) ((pixel & format12->Gmask) >> format12->Gshift);
+        *b = (Uint8) ((pixel & format12->Bmask) >> format12->Bshift);
+        *a = format12->Amask ? (Uint8) ((pixel & format12->Amask) >> format12->Ashift) : 255;
+        return;
+    }
+    SDL20_GetRGBA(pixel, PixelFormat12to20NoEnum(&format20, &palette20, format12), r, g, b, a);
 }
 
 DECLSPEC12 const SDL12_VideoInfo * SDLCALL
@@ -5834,7 +7233,7 @@ SDL_ListModes(const SDL12_PixelFormat *format12, Uint32 flags)
     VideoModeList *best_modes = NULL;
     Uint32 bpp;
     int i;
-    SDL_bool windowed_mode_list = SDL12Compat_GetHintBoolean("SDL12COMPAT_WINDOWED_MODE_LIST", SDL_FALSE);
+    SDL_bool windowed_mode_list = GetHintConfig()->windowed_mode_list;
 
     if (!SDL20_WasInit(SDL_INIT_VIDEO)) {
         SDL20_SetError("Video subsystem not initialized");
@@ -5986,11 +7385,110 @@ GetEnvironmentWindowPosition(int *x, int *y)
     }
 }
 
+/* Find a texture format the renderer supports that the screen's pixels can
+   be copied into as-is, so we don't have to convert them on every update.
+   Returns SDL_PIXELFORMAT_UNKNOWN if there isn't one. */
+static Uint32
+FindScreenTextureFormat(const SDL_RendererInfo *rinfo, const Uint32 appfmt)
+{
+    Uint32 i;
+
+    for (i = 0; i < rinfo->num_texture_formats; i++) {
+        if (rinfo->texture_formats[i] == appfmt) {
+            return appfmt;
+        }
+    }
+
+    /* The screen never has alpha, so an ARGB texture takes XRGB pixels
+       unchanged, as long as we draw it without blending. */
+    if (appfmt == SDL_PIXELFORMAT_XRGB8888) {
+        for (i = 0; i < rinfo->num_texture_formats; i++) {
+            if (rinfo->texture_formats[i] == SDL_PIXELFORMAT_ARGB8888) {
+                return SDL_PIXELFORMAT_ARGB8888;
+            }
+        }
+    }
+
+    return SDL_PIXELFORMAT_UNKNOWN;
+}
+
+/* With SDL2's software renderer, the renderer just draws into the window
+   surface anyhow, so when nothing needs scaling we can skip the texture
+   and convert the app's dirty rects straight into the window surface,
+   pushing only those rects to the screen. This saves a full-frame copy
+   and the renderer overhead, which matters on machines without a GPU. */
+static SDL_bool
+CanPresentToWindowSurface(void)
+{
+    SDL_RendererInfo rinfo;
+    SDL_Surface *surface;
+
+    if (!VideoRenderer20 || (SDL20_GetRendererInfo(VideoRenderer20, &rinfo) < 0)) {
+        return SDL_FALSE;
+    } else if ((rinfo.flags & SDL_RENDERER_SOFTWARE) == 0) {
+        return SDL_FALSE;  /* the GPU is doing the work, let it. */
+    }
+
+    surface = SDL20_GetWindowSurface(VideoWindow20);
+    if (!surface || (surface->w != VideoSurface12->w) || (surface->h != VideoSurface12->h)) {
+        return SDL_FALSE;  /* it's being scaled, the renderer has to do that. */
+    }
+    return SDL_TRUE;
+}
+
+/* the window changed size (fullscreen toggle, etc), so see if we can (still)
+   present straight to the window surface. Returns SDL_TRUE if that changed, in
+   which case the caller should push the whole screen through again. Call with
+   the renderer locked. */
+static SDL_bool
+RecheckWindowSurfacePresent(void)
+{
+    const SDL_bool was_present = VideoWindowSurfacePresent;
+    if (WantWindowSurfacePresent && ((VideoSurface12->flags & SDL12_OPENGL) == 0) && !VideoSurfaceHardwareBlits && !LiveYUVOverlays) {
+        VideoWindowSurfacePresent = CanPresentToWindowSurface();
+    } else {
+        VideoWindowSurfacePresent = SDL_FALSE;
+    }
+    VideoWindowSurfaceDirtyCount = 0;
+    VideoWindowSurfaceDirtyAll = SDL_FALSE;
+    return (was_present != VideoWindowSurfacePresent) ? SDL_TRUE : SDL_FALSE;
+}
+
+static void
+AddWindowSurfaceDirtyRect(const SDL_Rect *rect20)
+{
+    if (VideoWindowSurfaceDirtyAll) {
+        return;
+    } else if (VideoWindowSurfaceDirtyCount >= (int) SDL_arraysize(VideoWindowSurfaceDirty)) {
+        VideoWindowSurfaceDirtyAll = SDL_TRUE;  /* that's a lot of rects, just push the whole thing. */
+    } else {
+        SDL20_memcpy(&VideoWindowSurfaceDirty[VideoWindowSurfaceDirtyCount++], rect20, sizeof (SDL_Rect));
+    }
+}
+
+/* call with the renderer locked. */
+static void
+FlushWindowSurfaceDirtyRects(void)
+{
+    if (VideoWindowSurfaceDirtyAll) {
+        SDL20_UpdateWindowSurface(VideoWindow20);
+    } else if (VideoWindowSurfaceDirtyCount > 0) {
+        SDL20_UpdateWindowSurfaceRects(VideoWindow20, VideoWindowSurfaceDirty, VideoWindowSurfaceDirtyCount);
+    }
+    VideoWindowSurfaceDirtyCount = 0;
+    VideoWindowSurfaceDirtyAll = SDL_FALSE;
+}
+
+static void ClearGLProcCache(void);
 static SDL12_Surface *
 EndVidModeCreate(void)
 {
     QueuedOverlayItem *overlay;
 
+    DiscardDisplayList();
+    VideoSurfaceHardwareBlits = SDL_FALSE;
+    VideoWindowSurfacePresent = SDL_FALSE;
+
     if (OpenGLBlitTexture) {
         OpenGLFuncs.glDeleteTextures(1, &OpenGLBlitTexture);
         OpenGLBlitTexture = 0;
@@ -6000,9 +7498,15 @@ EndVidModeCreate(void)
         VideoTexture20 = NULL;
     }
     if (VideoRenderer20) {
+        if (WantDebugLogging) {
+            SDL20_Log("Renderer GL context was released %u times", (unsigned int) VideoRendererContextReleases);
+        }
         SDL20_DestroyRenderer(VideoRenderer20);
         VideoRenderer20 = NULL;
+        VideoRendererGeneration++;
     }
+    VideoRendererKeepsContext = SDL_FALSE;
+    VideoRendererContextReleases = 0;
     if (VideoRendererLock) {
         SDL20_DestroyMutex(VideoRendererLock);
         VideoRendererLock = NULL;
@@ -6012,6 +7516,7 @@ EndVidModeCreate(void)
         SDL20_GL_DeleteContext(VideoGLContext20);
         VideoGLContext20 = NULL;
     }
+    ClearGLProcCache();  /* any addresses we handed out belonged to the old context. */
     if (VideoWindow20) {
         SDL20_DestroyWindow(VideoWindow20);
         VideoWindow20 = NULL;
@@ -6021,7 +7526,7 @@ EndVidModeCreate(void)
         VideoPhysicalPalette20 = NULL;
     }
     if (VideoSurface12) {
-        SDL20_free(VideoSurface12->pixels);
+        FreeSurfacePixels(VideoSurface12->pixels);
         VideoSurface12->pixels = NULL;
         FreeSurfaceContents(VideoSurface12);
     }
@@ -6030,6 +7535,10 @@ EndVidModeCreate(void)
         VideoConvertSurface20 = NULL;
     }
 
+    if (WantDebugLogging && (OpenGLMultisampleResolves || OpenGLMultisampleResolvesSkipped)) {
+        SDL20_Log("MSAA readback resolves: %u performed, %u skipped", (unsigned int) OpenGLMultisampleResolves, (unsigned int) OpenGLMultisampleResolvesSkipped);
+    }
+
     SDL20_zero(OpenGLFuncs);
     OpenGLBlitLockCount = 0;
     OpenGLLogicalScalingWidth = 0;
@@ -6040,6 +7549,8 @@ EndVidModeCreate(void)
     OpenGLLogicalScalingMultisampleFBO = 0;
     OpenGLLogicalScalingMultisampleColor = 0;
     OpenGLLogicalScalingMultisampleDepth = 0;
+    OpenGLLogicalScalingMultisampleDirty = SDL_TRUE;
+    OpenGLMultisampleResolves = OpenGLMultisampleResolvesSkipped = 0;
 
     MouseInputIsRelative = SDL_FALSE;
     MousePosition.x = 0;
@@ -6048,12 +7559,23 @@ EndVidModeCreate(void)
     overlay = QueuedDisplayOverlays.next;
     while (overlay != NULL) {
         QueuedOverlayItem *next = overlay->next;
-        SDL_free(overlay);
+        if (overlay->overlay12) {
+            ((SDL12_YUVData *) overlay->overlay12->hwdata)->queued[overlay->texture]--;
+        }
+        SDL20_free(overlay);
         overlay = next;
     }
     QueuedDisplayOverlays.next = NULL;
     QueuedDisplayOverlaysTail = &QueuedDisplayOverlays;
 
+    overlay = QueuedOverlayItemPool;
+    while (overlay != NULL) {
+        QueuedOverlayItem *next = overlay->next;
+        SDL20_free(overlay);
+        overlay = next;
+    }
+    QueuedOverlayItemPool = NULL;
+
     VideoSurfaceUpdatedInBackgroundThread = SDL_FALSE;
     SetVideoModeThread = 0;
 
@@ -6157,6 +7679,29 @@ ResolveFauxBackbufferMSAA(void)
     }
     OpenGLFuncs.glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGLCurrentReadFBO);
     OpenGLFuncs.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OpenGLCurrentDrawFBO);
+
+    OpenGLLogicalScalingMultisampleDirty = SDL_FALSE;
+    OpenGLMultisampleResolves++;
+}
+
+/* Reading from the default framebuffer with multisampling on means reading from
+   the resolved copy, so it has to be brought up to date first. Normally we
+   resolve on every read, but with SDL12COMPAT_MSAA_RESOLVE_TRACKING we only do
+   it if something might have drawn to the multisample FBO since the last
+   resolve, so apps that read back lots of little regions per frame don't pay
+   for a full-screen blit each time. We can only see the draws that go through
+   entry points we handed out (and binds of the window framebuffer), which is
+   why this is opt-in. */
+static SDL_bool
+NeedFauxBackbufferMSAAResolve(void)
+{
+    if (!OpenGLLogicalScalingMultisampleFBO || (OpenGLCurrentReadFBO != OpenGLLogicalScalingMultisampleFBO)) {
+        return SDL_FALSE;
+    } else if (WantMSAAResolveTracking && !OpenGLLogicalScalingMultisampleDirty) {
+        OpenGLMultisampleResolvesSkipped++;
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
 }
 
 /* if the app binds its own framebuffer objects, it'll try to bind the window framebuffer
@@ -6183,10 +7728,13 @@ glBindFramebuffer_shim_for_scaling(GLenum target, GLuint name)
 
     if ((target == GL_DRAW_FRAMEBUFFER) || (target == GL_FRAMEBUFFER)) {
         OpenGLCurrentDrawFBO = (name == 0) ? OpenGLLogicalScalingFBO : name;
+        if (name == 0) {
+            OpenGLLogicalScalingMultisampleDirty = SDL_TRUE;  /* assume they're going to draw to it. */
+        }
     }
 
     /* If multisampling is enabled, and we're trying using the default framebuffer, do a multisample resolve. */
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO)) {
+    if (NeedFauxBackbufferMSAAResolve()) {
         ResolveFauxBackbufferMSAA();
     } else {
         /* ResolveFauxBackbufferMSAA() will bind the framebuffers, otherwise we have to do it manually */
@@ -6199,7 +7747,7 @@ glBindFramebuffer_shim_for_scaling(GLenum target, GLuint name)
 static void GLAPIENTRY
 glReadPixels_shim_for_scaling(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *data)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glReadPixels(x, y, width, height, format, type, data);
 }
@@ -6207,15 +7755,18 @@ glReadPixels_shim_for_scaling(GLint x, GLint y, GLsizei width, GLsizei height, G
 static void GLAPIENTRY
 glCopyPixels_shim_for_scaling(GLint x, GLint y, GLsizei width, GLsizei height, GLenum type)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glCopyPixels(x, y, width, height, type);
+    if (OpenGLCurrentDrawFBO == OpenGLLogicalScalingFBO) {
+        OpenGLLogicalScalingMultisampleDirty = SDL_TRUE;  /* this writes to the draw framebuffer, too. */
+    }
 }
 
 static void GLAPIENTRY
 glCopyTexImage1D_shim_for_scaling(GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLint border)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glCopyTexImage1D(target, level, internalformat, x, y, width, border);
 }
@@ -6223,7 +7774,7 @@ glCopyTexImage1D_shim_for_scaling(GLenum target, GLint level, GLenum internalfor
 static void GLAPIENTRY
 glCopyTexSubImage1D_shim_for_scaling(GLenum target, GLint level, GLint xoffset, GLint x, GLint y, GLsizei width)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glCopyTexSubImage1D(target, level, xoffset, x, y, width);
 }
@@ -6231,7 +7782,7 @@ glCopyTexSubImage1D_shim_for_scaling(GLenum target, GLint level, GLint xoffset,
 static void GLAPIENTRY
 glCopyTexImage2D_shim_for_scaling(GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glCopyTexImage2D(target, level, internalformat, x, y, width, height, border);
 }
@@ -6239,7 +7790,7 @@ glCopyTexImage2D_shim_for_scaling(GLenum target, GLint level, GLenum internalfor
 static void GLAPIENTRY
 glCopyTexSubImage2D_shim_for_scaling(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glCopyTexSubImage2D(target, level, xoffset, yoffset, x, y, width, height);
 }
@@ -6247,11 +7798,130 @@ glCopyTexSubImage2D_shim_for_scaling(GLenum target, GLint level, GLint xoffset,
 static void GLAPIENTRY
 glCopyTexSubImage3D_shim_for_scaling(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    if (OpenGLLogicalScalingMultisampleFBO && (OpenGLCurrentReadFBO == OpenGLLogicalScalingMultisampleFBO))
+    if (NeedFauxBackbufferMSAAResolve())
         ResolveFauxBackbufferMSAA();
     OpenGLFuncs.glCopyTexSubImage3D(target, level, xoffset, yoffset, zoffset, x, y, width, height);
 }
 
+/* These are only handed out with SDL12COMPAT_MSAA_RESOLVE_TRACKING, to notice
+   rendering that makes the resolved copy of the multisample FBO stale. */
+#define MARK_MSAA_DIRTY() if (OpenGLCurrentDrawFBO == OpenGLLogicalScalingFBO) { OpenGLLogicalScalingMultisampleDirty = SDL_TRUE; }
+
+static void GLAPIENTRY
+glClear_shim_for_scaling(GLbitfield mask)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glClear(mask);
+}
+
+static void GLAPIENTRY
+glEnd_shim_for_scaling(void)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glEnd();
+}
+
+static void GLAPIENTRY
+glDrawArrays_shim_for_scaling(GLenum mode, GLint first, GLsizei count)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glDrawArrays(mode, first, count);
+}
+
+static void GLAPIENTRY
+glDrawElements_shim_for_scaling(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glDrawElements(mode, count, type, indices);
+}
+
+static void GLAPIENTRY
+glCallList_shim_for_scaling(GLuint list)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glCallList(list);
+}
+
+static void GLAPIENTRY
+glCallLists_shim_for_scaling(GLsizei n, GLenum type, const GLvoid *lists)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glCallLists(n, type, lists);
+}
+
+static void GLAPIENTRY
+glDrawPixels_shim_for_scaling(GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glDrawPixels(width, height, format, type, pixels);
+}
+
+static void GLAPIENTRY
+glBitmap_shim_for_scaling(GLsizei width, GLsizei height, GLfloat xorig, GLfloat yorig, GLfloat xmove, GLfloat ymove, const GLubyte *bitmap)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glBitmap(width, height, xorig, yorig, xmove, ymove, bitmap);
+}
+
+#define GLRECT_SHIMS(suffix, type) \
+    static void GLAPIENTRY glRect##suffix##_shim_for_scaling(type x1, type y1, type x2, type y2) { \
+        MARK_MSAA_DIRTY(); \
+        OpenGLFuncs.glRect##suffix(x1, y1, x2, y2); \
+    } \
+    static void GLAPIENTRY glRect##suffix##v_shim_for_scaling(const type *v1, const type *v2) { \
+        MARK_MSAA_DIRTY(); \
+        OpenGLFuncs.glRect##suffix##v(v1, v2); \
+    }
+GLRECT_SHIMS(d, GLdouble)
+GLRECT_SHIMS(f, GLfloat)
+GLRECT_SHIMS(i, GLint)
+GLRECT_SHIMS(s, GLshort)
+#undef GLRECT_SHIMS
+
+static void GLAPIENTRY
+glDrawRangeElements_shim_for_scaling(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glDrawRangeElements(mode, start, end, count, type, indices);
+}
+
+static void GLAPIENTRY
+glMultiDrawArrays_shim_for_scaling(GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glMultiDrawArrays(mode, first, count, drawcount);
+}
+
+static void GLAPIENTRY
+glMultiDrawElements_shim_for_scaling(GLenum mode, const GLsizei *count, GLenum type, const GLvoid * const *indices, GLsizei drawcount)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glMultiDrawElements(mode, count, type, indices, drawcount);
+}
+
+static void GLAPIENTRY
+glDrawArraysInstanced_shim_for_scaling(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glDrawArraysInstanced(mode, first, count, instancecount);
+}
+
+static void GLAPIENTRY
+glDrawElementsInstanced_shim_for_scaling(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glDrawElementsInstanced(mode, count, type, indices, instancecount);
+}
+
+static void GLAPIENTRY
+glBlitFramebuffer_shim_for_scaling(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+{
+    MARK_MSAA_DIRTY();
+    OpenGLFuncs.glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+}
+
+#undef MARK_MSAA_DIRTY
+
 static SDL_bool
 InitializeOpenGLScaling(const int w, const int h)
 {
@@ -6306,100 +7976,429 @@ InitializeOpenGLScaling(const int w, const int h)
 
     OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
-    if ((OpenGLFuncs.glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) || OpenGLFuncs.glGetError()) {
-        OpenGLFuncs.glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingColor);
-        OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingDepth);
-        OpenGLFuncs.glDeleteFramebuffers(1, &OpenGLLogicalScalingFBO);
-        OpenGLLogicalScalingFBO = OpenGLLogicalScalingColor = OpenGLLogicalScalingDepth = 0;
+    if ((OpenGLFuncs.glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) || OpenGLFuncs.glGetError()) {
+        OpenGLFuncs.glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingColor);
+        OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingDepth);
+        OpenGLFuncs.glDeleteFramebuffers(1, &OpenGLLogicalScalingFBO);
+        OpenGLLogicalScalingFBO = OpenGLLogicalScalingColor = OpenGLLogicalScalingDepth = 0;
+        return SDL_FALSE;
+    }
+
+    if (OpenGLLogicalScalingSamples) {
+        if (!OpenGLLogicalScalingMultisampleFBO) {
+            OpenGLFuncs.glGenFramebuffers(1, &OpenGLLogicalScalingMultisampleFBO);
+        }
+        if (!OpenGLLogicalScalingMultisampleColor) {
+            OpenGLFuncs.glGenRenderbuffers(1, &OpenGLLogicalScalingMultisampleColor);
+        }
+        if (!OpenGLLogicalScalingMultisampleDepth) {
+            OpenGLFuncs.glGenRenderbuffers(1, &OpenGLLogicalScalingMultisampleDepth);
+        }
+
+        OpenGLFuncs.glBindFramebuffer(GL_FRAMEBUFFER, OpenGLLogicalScalingMultisampleFBO);
+        OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleColor);
+        OpenGLFuncs.glRenderbufferStorage(GL_RENDERBUFFER, (alpha_size > 0) ? GL_RGBA8 : GL_RGB8, w, h);
+        OpenGLFuncs.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleColor);
+
+        if (depth_size || stencil_size) {
+            OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleDepth);
+            OpenGLFuncs.glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+            if (depth_size) {
+                OpenGLFuncs.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleDepth);
+            }
+            if (stencil_size) {
+                OpenGLFuncs.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleDepth);
+            }
+        }
+
+        OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        if ((OpenGLFuncs.glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) || OpenGLFuncs.glGetError()) {
+            OpenGLFuncs.glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingMultisampleColor);
+            OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingMultisampleDepth);
+            OpenGLFuncs.glDeleteFramebuffers(1, &OpenGLLogicalScalingMultisampleFBO);
+            OpenGLLogicalScalingMultisampleFBO = OpenGLLogicalScalingMultisampleColor = OpenGLLogicalScalingMultisampleDepth = 0;
+        }
+        OpenGLFuncs.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OpenGLLogicalScalingFBO);
+        OpenGLFuncs.glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGLLogicalScalingMultisampleFBO);
+    }
+
+    /* initialise the cached current FBO bindings properly */
+    OpenGLCurrentReadFBO = OpenGLLogicalScalingMultisampleFBO ? OpenGLLogicalScalingMultisampleFBO : OpenGLLogicalScalingFBO;
+    OpenGLCurrentDrawFBO = OpenGLLogicalScalingFBO;
+    OpenGLLogicalScalingMultisampleDirty = SDL_TRUE;
+
+    OpenGLFuncs.glViewport(0, 0, w, h);
+    OpenGLFuncs.glScissor(0, 0, w, h);
+    OpenGLLogicalScalingWidth = w;
+    OpenGLLogicalScalingHeight = h;
+
+    OpenGLFuncs.glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return SDL_TRUE;
+}
+
+
+/* The idea here is that SDL's OpenGL-based renderers always notice if
+   they aren't using the correct context and attempt to set the correct
+   context before doing any work, but (at least for X11, and probably
+   other platforms), the current context is thread-local, and _it's an
+   error to set a context current if it's already current on another thread_.
+   So we try to catch every place we call into the renderer and end that
+   work with a call to this function, which will reset the GL context to NULL,
+   so if an app tries to render from a background thread, the GL renderer
+   will be able to set the context, do it's work, and then we reset it right
+   after. Without this, we either need all apps to render exclusively on
+   the main thread or fail to draw at all.
+
+   This feels risky, but it's better than the alternative!
+
+   Also, the renderer API isn't thread safe in general, so wrapping it
+   in a mutex is necessary anyhow.
+
+   Dropping the context on every unlock makes the renderer set it again on
+   the next lock, though, and we lock several times a frame, so on X11 a
+   single-threaded game pays for two context switches per renderer call.
+   So, as long as the app hasn't created any threads or timers (through
+   SDL_CreateThread and SDL_AddTimer, or so we hope), we leave the context
+   current on the thread that called SDL_SetVideoMode. The first time the app
+   makes one, we drop the context right there and go back to the paranoid
+   behavior for good. SDL12COMPAT_GL_CONTEXT_AFFINITY=0 turns this off. */
+
+static SDL_Renderer *
+LockVideoRenderer(void)
+{
+    SDL20_LockMutex(VideoRendererLock);
+    if (VideoRendererKeepsContext && !VideoRendererThreaded && (SDL20_ThreadID() != SetVideoModeThread)) {
+        /* Someone is drawing from a thread we didn't see being created. We can't
+           take the context back from the other thread here, so this draw might
+           fail, but stop holding onto the context from now on. */
+        if (WantDebugLogging) {
+            SDL20_Log("Renderer used from an unexpected thread; no longer keeping the GL context current.");
+        }
+        VideoRendererThreaded = SDL_TRUE;
+    }
+    return VideoRenderer20;
+}
+
+static void
+UnlockVideoRenderer(void)
+{
+    if ((VideoRenderer20 != NULL) && (SDL20_GL_GetCurrentContext() != NULL)) {
+        if (WantGLContextAffinity && !VideoRendererThreaded && (SDL20_ThreadID() == SetVideoModeThread)) {
+            VideoRendererKeepsContext = SDL_TRUE;
+        } else {
+            SDL20_GL_MakeCurrent(NULL, NULL);
+            VideoRendererKeepsContext = SDL_FALSE;
+            VideoRendererContextReleases++;
+        }
+    }
+    SDL20_UnlockMutex(VideoRendererLock);
+}
+
+/* Call this when the app creates a thread, since it might draw from it. */
+static void
+NoteAppThreadCreated(void)
+{
+    if (!VideoRendererThreaded) {
+        VideoRendererThreaded = SDL_TRUE;
+        if (VideoRendererLock) {
+            LockVideoRenderer();
+            UnlockVideoRenderer();  /* this drops the context if it's current here. */
+        }
+    }
+}
+
+/* SDL12COMPAT_HW_BLITS support.
+
+   If the app asks for an SDL_HWSURFACE screen, surfaces it creates with
+   SDL_HWSURFACE (or gets from SDL_DisplayFormat*) are marked as hardware
+   surfaces and get an SDL2 texture. Blits from them to the screen don't
+   touch the screen's pixels; they're recorded in a display list and drawn
+   with SDL_RenderCopy on top of the screen texture when we present.
+
+   The software screen surface doesn't have these blits in it, so anything
+   that reads or writes the screen's pixels (locking it, filling it,
+   software blits to or from it, etc) first "flushes" the display list:
+   the recorded blits are done in software, in order, and the result is
+   uploaded to the screen texture. The same happens if a surface that's in
+   the display list is about to change, since the GPU would otherwise draw
+   its new contents instead of what was there at blit time.
+
+   After a present, the display list is kept, since the software surface
+   still doesn't have those blits in it. A new opaque blit that covers the
+   whole screen makes everything before it irrelevant, though, so games that
+   redraw the whole frame each time never actually flush anything. */
+typedef struct HardwareSurface12
+{
+    SDL_Texture *texture;  /* NULL until needed, and after the surface's pixels change. */
+    Uint32 generation;  /* VideoRendererGeneration when the texture was made. */
+    int listrefs;  /* number of display list items using this surface. */
+} HardwareSurface12;
+
+typedef struct DisplayListItem
+{
+    SDL12_Surface *src12;  /* we hold a reference on this. */
+    SDL_Rect srcrect;
+    SDL_Rect dstrect;
+} DisplayListItem;
+
+#define MAX_DISPLAY_LIST_ITEMS 8192
+
+static DisplayListItem *DisplayList = NULL;
+static int DisplayListCount = 0;
+static int DisplayListAllocated = 0;
+static SDL_bool DisplayListHidesScreen = SDL_FALSE;  /* an opaque blit covers all of the screen texture. */
+
+static HardwareSurface12 *
+GetHardwareSurface(SDL12_Surface *surface12)
+{
+    if (surface12 && (surface12 != VideoSurface12) && (surface12->flags & SDL12_HWSURFACE) && surface12->surface20) {
+        return (HardwareSurface12 *) surface12->surface20->userdata;
+    }
+    return NULL;
+}
+
+static void
+MarkHardwareSurface(SDL12_Surface *surface12)
+{
+    HardwareSurface12 *hw;
+
+    if (!VideoSurfaceHardwareBlits || !surface12 || (surface12->format->BitsPerPixel == 8)) {
+        return;  /* paletted surfaces stay in software; palette changes would need new textures constantly. */
+    }
+
+    hw = (HardwareSurface12 *) SDL20_calloc(1, sizeof (HardwareSurface12));
+    if (hw) {  /* if this fails, it just stays a software surface. */
+        surface12->surface20->userdata = hw;
+        surface12->flags |= SDL12_HWSURFACE;
+    }
+}
+
+static void
+DropHardwareTexture(HardwareSurface12 *hw)
+{
+    if (hw->texture) {
+        if (hw->generation == VideoRendererGeneration) {  /* otherwise the renderer already destroyed it. */
+            LockVideoRenderer();
+            SDL20_DestroyTexture(hw->texture);
+            UnlockVideoRenderer();
+        }
+        hw->texture = NULL;
+    }
+}
+
+static void
+FreeHardwareSurface(SDL12_Surface *surface12)
+{
+    HardwareSurface12 *hw = GetHardwareSurface(surface12);
+    if (hw) {
+        SDL_assert(hw->listrefs == 0);  /* the display list holds a reference, so this shouldn't be freed yet. */
+        DropHardwareTexture(hw);
+        SDL20_free(hw);
+        surface12->surface20->userdata = NULL;
+        surface12->flags &= ~SDL12_HWSURFACE;
+    }
+}
+
+/* call with the renderer locked. */
+static void
+ReleaseDisplayListItems(void)
+{
+    int i;
+    for (i = 0; i < DisplayListCount; i++) {
+        SDL12_Surface *src12 = DisplayList[i].src12;
+        HardwareSurface12 *hw = GetHardwareSurface(src12);
+        if (hw) {
+            hw->listrefs--;
+        }
+        SDL_FreeSurface(src12);
+    }
+    DisplayListCount = 0;
+    DisplayListHidesScreen = SDL_FALSE;
+}
+
+static void
+DiscardDisplayList(void)
+{
+    LockVideoRenderer();
+    ReleaseDisplayListItems();
+    SDL20_free(DisplayList);
+    DisplayList = NULL;
+    DisplayListAllocated = 0;
+    UnlockVideoRenderer();
+}
+
+/* call with the renderer locked. */
+static void
+UploadWholeVideoSurface(void)
+{
+    const int pixsize = VideoSurface12->format->BytesPerPixel;
+    const int srcpitch = VideoSurface12->pitch;
+    void *pixels = NULL;
+    int pitch = 0;
+
+    SDL_assert(!VideoConvertSurface20);  /* we don't do hardware blits when the screen needs conversion. */
+
+    if (SDL20_LockTexture(VideoTexture20, NULL, &pixels, &pitch) == 0) {
+        const int cpy = VideoSurface12->w * pixsize;
+        const Uint8 *src = (const Uint8 *) VideoSurface12->pixels;
+        Uint8 *dst = (Uint8 *) pixels;
+        int y;
+        for (y = 0; y < VideoSurface12->h; y++) {
+            SDL20_memcpy(dst, src, cpy);
+            src += srcpitch;
+            dst += pitch;
+        }
+        SDL20_UnlockTexture(VideoTexture20);
+    }
+}
+
+/* Do all the recorded blits in software, so the screen surface has
+   everything in it, and get the screen texture up to date to match.
+   The recorded rects were clipped against the screen's clip rect when the
+   blit was made, so these are LowerBlits; the app might have changed the
+   clip rect since then, and that shouldn't cut off earlier blits. */
+static void
+FlushDisplayList(void)
+{
+    if (!DisplayListCount) {
+        return;
+    }
+
+    if (LockVideoRenderer()) {
+        int i;
+        for (i = 0; i < DisplayListCount; i++) {
+            const DisplayListItem *item = &DisplayList[i];
+            SDL_Rect srcrect20, dstrect20;
+            SDL20_memcpy(&srcrect20, &item->srcrect, sizeof (SDL_Rect));
+            SDL20_memcpy(&dstrect20, &item->dstrect, sizeof (SDL_Rect));
+            SDL20_LowerBlit(item->src12->surface20, &srcrect20, VideoSurface12->surface20, &dstrect20);
+        }
+
+        if (WantDebugLogging) {
+            SDL20_Log("Flushed %d hardware blits to the software screen surface", DisplayListCount);
+        }
+
+        ReleaseDisplayListItems();
+        UploadWholeVideoSurface();
+    }
+    UnlockVideoRenderer();
+}
+
+/* Call before changing a surface's pixels (or anything else that changes how it blits). */
+static void
+SurfaceWillChange12(SDL12_Surface *surface12)
+{
+    HardwareSurface12 *hw;
+
+    if (!VideoSurfaceHardwareBlits || !surface12) {
+        return;
+    } else if (surface12 == VideoSurface12) {
+        FlushDisplayList();
+        return;
+    }
+
+    hw = GetHardwareSurface(surface12);
+    if (hw) {
+        if (hw->listrefs) {
+            FlushDisplayList();
+        }
+        DropHardwareTexture(hw);
+    }
+}
+
+/* Call before reading a surface's pixels. */
+static void
+SurfaceWillBeRead12(SDL12_Surface *surface12)
+{
+    if (VideoSurfaceHardwareBlits && (surface12 == VideoSurface12)) {
+        FlushDisplayList();
+    }
+}
+
+/* Returns SDL_FALSE if this should be a normal software blit. */
+static SDL_bool
+RecordHardwareBlit(SDL12_Surface *src12, const SDL_Rect *srcrect20, SDL12_Surface *dst12, SDL_Rect *dstrect20, int *retval)
+{
+    HardwareSurface12 *hw = GetHardwareSurface(src12);
+    SDL_Renderer *renderer;
+    DisplayListItem *item;
+    SDL_Rect sr, dr;
+
+    if (!VideoSurfaceHardwareBlits || !hw || (dst12 != VideoSurface12)) {
+        return SDL_FALSE;
+    } else if (SDL20_ThreadID() != SetVideoModeThread) {
         return SDL_FALSE;
+    } else if (src12->surface20->locked || VideoSurface12->surface20->locked) {
+        return SDL_FALSE;  /* let SDL2 report the error. */
+    } else if (!ClipUpperBlit(src12->surface20, srcrect20, VideoSurface12->surface20, dstrect20, &sr, &dr)) {
+        return SDL_FALSE;  /* SDL2 will figure out the empty blit. */
     }
 
-    if (OpenGLLogicalScalingSamples) {
-        if (!OpenGLLogicalScalingMultisampleFBO) {
-            OpenGLFuncs.glGenFramebuffers(1, &OpenGLLogicalScalingMultisampleFBO);
-        }
-        if (!OpenGLLogicalScalingMultisampleColor) {
-            OpenGLFuncs.glGenRenderbuffers(1, &OpenGLLogicalScalingMultisampleColor);
-        }
-        if (!OpenGLLogicalScalingMultisampleDepth) {
-            OpenGLFuncs.glGenRenderbuffers(1, &OpenGLLogicalScalingMultisampleDepth);
-        }
-
-        OpenGLFuncs.glBindFramebuffer(GL_FRAMEBUFFER, OpenGLLogicalScalingMultisampleFBO);
-        OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleColor);
-        OpenGLFuncs.glRenderbufferStorage(GL_RENDERBUFFER, (alpha_size > 0) ? GL_RGBA8 : GL_RGB8, w, h);
-        OpenGLFuncs.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleColor);
+    renderer = LockVideoRenderer();
+    if (!renderer) {
+        UnlockVideoRenderer();
+        return SDL_FALSE;
+    }
 
-        if (depth_size || stencil_size) {
-            OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleDepth);
-            OpenGLFuncs.glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
-            if (depth_size) {
-                OpenGLFuncs.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleDepth);
-            }
-            if (stencil_size) {
-                OpenGLFuncs.glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, OpenGLLogicalScalingMultisampleDepth);
-            }
+    if (!hw->texture || (hw->generation != VideoRendererGeneration)) {
+        hw->texture = SDL20_CreateTextureFromSurface(renderer, src12->surface20);
+        hw->generation = VideoRendererGeneration;
+        if (!hw->texture) {
+            UnlockVideoRenderer();
+            return SDL_FALSE;
         }
+    }
 
-        OpenGLFuncs.glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    /* An opaque blit over the whole screen hides everything before it. */
+    if ((dr.x == 0) && (dr.y == 0) && (dr.w == VideoSurface12->w) && (dr.h == VideoSurface12->h) &&
+        ((src12->flags & (SDL12_SRCALPHA|SDL12_SRCCOLORKEY)) == 0)) {
+        ReleaseDisplayListItems();
+        DisplayListHidesScreen = SDL_TRUE;
+    } else if (DisplayListCount >= MAX_DISPLAY_LIST_ITEMS) {
+        FlushDisplayList();  /* this is getting out of hand, bake it into the software surface. */
+    }
 
-        if ((OpenGLFuncs.glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) || OpenGLFuncs.glGetError()) {
-            OpenGLFuncs.glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingMultisampleColor);
-            OpenGLFuncs.glDeleteRenderbuffers(1, &OpenGLLogicalScalingMultisampleDepth);
-            OpenGLFuncs.glDeleteFramebuffers(1, &OpenGLLogicalScalingMultisampleFBO);
-            OpenGLLogicalScalingMultisampleFBO = OpenGLLogicalScalingMultisampleColor = OpenGLLogicalScalingMultisampleDepth = 0;
+    if (DisplayListCount >= DisplayListAllocated) {
+        const int newalloc = DisplayListAllocated ? (DisplayListAllocated * 2) : 64;
+        void *ptr = SDL20_realloc(DisplayList, newalloc * sizeof (DisplayListItem));
+        if (!ptr) {
+            UnlockVideoRenderer();
+            return SDL_FALSE;
         }
-        OpenGLFuncs.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OpenGLLogicalScalingFBO);
-        OpenGLFuncs.glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGLLogicalScalingMultisampleFBO);
+        DisplayList = (DisplayListItem *) ptr;
+        DisplayListAllocated = newalloc;
     }
 
-    /* initialise the cached current FBO bindings properly */
-    OpenGLCurrentReadFBO = OpenGLLogicalScalingMultisampleFBO ? OpenGLLogicalScalingMultisampleFBO : OpenGLLogicalScalingFBO;
-    OpenGLCurrentDrawFBO = OpenGLLogicalScalingFBO;
+    item = &DisplayList[DisplayListCount++];
+    item->src12 = src12;
+    SDL20_memcpy(&item->srcrect, &sr, sizeof (SDL_Rect));
+    SDL20_memcpy(&item->dstrect, &dr, sizeof (SDL_Rect));
+    src12->refcount++;
+    hw->listrefs++;
 
-    OpenGLFuncs.glViewport(0, 0, w, h);
-    OpenGLFuncs.glScissor(0, 0, w, h);
-    OpenGLLogicalScalingWidth = w;
-    OpenGLLogicalScalingHeight = h;
+    UnlockVideoRenderer();
 
-    OpenGLFuncs.glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (dstrect20) {  /* SDL2 writes the final clipped rect back to dstrect, so we do too. */
+        SDL20_memcpy(dstrect20, &dr, sizeof (SDL_Rect));
+    }
+    *retval = 0;
     return SDL_TRUE;
 }
 
-
-/* The idea here is that SDL's OpenGL-based renderers always notice if
-   they aren't using the correct context and attempt to set the correct
-   context before doing any work, but (at least for X11, and probably
-   other platforms), the current context is thread-local, and _it's an
-   error to set a context current if it's already current on another thread_.
-   So we try to catch every place we call into the renderer and end that
-   work with a call to this function, which will reset the GL context to NULL,
-   so if an app tries to render from a background thread, the GL renderer
-   will be able to set the context, do it's work, and then we reset it right
-   after. Without this, we either need all apps to render exclusively on
-   the main thread or fail to draw at all.
-
-   This feels risky, but it's better than the alternative!
-
-   Also, the renderer API isn't thread safe in general, so wrapping it
-   in a mutex is necessary anyhow. */
-
-static SDL_Renderer *
-LockVideoRenderer(void)
-{
-    SDL20_LockMutex(VideoRendererLock);
-    return VideoRenderer20;
-}
-
+/* call with the renderer locked. */
 static void
-UnlockVideoRenderer(void)
+RenderDisplayList(SDL_Renderer *renderer)
 {
-    if ((VideoRenderer20 != NULL) && (SDL20_GL_GetCurrentContext() != NULL)) {
-        SDL20_GL_MakeCurrent(NULL, NULL);
+    int i;
+    for (i = 0; i < DisplayListCount; i++) {
+        const DisplayListItem *item = &DisplayList[i];
+        const HardwareSurface12 *hw = GetHardwareSurface(item->src12);
+        SDL_assert(hw && hw->texture);
+        SDL20_RenderCopy(renderer, hw->texture, &item->srcrect, &item->dstrect);
     }
-    SDL20_UnlockMutex(VideoRendererLock);
 }
 
 static void UpdateInputGrab(void);
@@ -6422,9 +8421,10 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
     SDL_DisplayMode dmode;
     Uint32 fullscreen_flags20 = 0;
     Uint32 appfmt;
-    const char *vsync_env = SDL12Compat_GetHint("SDL12COMPAT_SYNC_TO_VBLANK");
-    float window_size_scaling = SDL12Compat_GetHintFloat("SDL12COMPAT_WINDOW_SCALING", 1.0f);
-    int max_bpp = SDL12Compat_GetHintInt("SDL12COMPAT_MAX_BPP", 32);
+    char vsync_env[16];
+    SDL_bool have_vsync_env;
+    float window_size_scaling = GetHintConfig()->window_scaling;
+    int max_bpp = GetHintConfig()->max_bpp;
     SDL_bool use_gl_scaling = SDL_FALSE;
     SDL_bool use_highdpi = SDL_TRUE;
     SDL_bool fix_bordless_fs_win = SDL_TRUE;
@@ -6432,7 +8432,10 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
     int scaled_height = height;
     const char *fromwin_env = NULL;
     int gl_max_fps;
+    Uint64 phase_start;
     SDL_bool force_display_mode = SDL_FALSE;
+
+    have_vsync_env = CopyHintString(&GetHintConfig()->sync_to_vblank, vsync_env, sizeof (vsync_env));
     VideoSurface12 = &VideoSurface12Location;
 
     if (flags12 & SDL12_OPENGL) {
@@ -6458,18 +8461,18 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
            is never used for windows, it is always false there. */
         use_highdpi = (flags12 & SDL12_FULLSCREEN) ? use_gl_scaling : SDL_FALSE;
 
-        gl_max_fps = SDL12Compat_GetHintInt("SDL12COMPAT_MAX_FPS", 0);
+        gl_max_fps = GetHintConfig()->max_fps;
         if (gl_max_fps != 0) {
             OpenGLBuffersSwapTickInterval = 1000.f / gl_max_fps;
             OpenGLBuffersLastSwapTicks = SDL20_GetTicks();
         }
     }
 
-    use_highdpi = SDL12Compat_GetHintBoolean("SDL12COMPAT_HIGHDPI", use_highdpi);
+    use_highdpi = HintTristate(GetHintConfig()->highdpi, use_highdpi);
 
-    fix_bordless_fs_win = SDL12Compat_GetHintBoolean("SDL12COMPAT_FIX_BORDERLESS_FS_WIN", fix_bordless_fs_win);
+    fix_bordless_fs_win = HintTristate(GetHintConfig()->fix_borderless_fs_win, fix_bordless_fs_win);
 
-    ForceGLSwapBufferContext = SDL12Compat_GetHintBoolean("SDL12COMPAT_FORCE_GL_SWAPBUFFER_CONTEXT", SDL_FALSE);
+    ForceGLSwapBufferContext = GetHintConfig()->force_gl_swapbuffer_context;
 
     flags12 &= ~SDL12_HWACCEL; /* just in case - https://github.com/libsdl-org/SDL-1.2/issues/817 */
 
@@ -6644,12 +8647,14 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
             SDL20_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, OpenGLLogicalScalingSamples);
         }
 
+        phase_start = BeginStartupPhase();
         VideoWindow20 = SDL20_CreateWindow(WindowTitle, x, y, scaled_width, scaled_height, flags20);
         if (!VideoWindow20 && (flags20 & SDL_WINDOW_OPENGL) && !(flags12 & SDL12_OPENGL)) {
             /* OpenGL might not be installed, try again without that flag */
             flags20 &= ~SDL_WINDOW_OPENGL;
             VideoWindow20 = SDL20_CreateWindow(WindowTitle, x, y, scaled_width, scaled_height, flags20);
         }
+        EndStartupPhase(STARTUP_PHASE_CREATE_WINDOW, phase_start);
         if (!VideoWindow20) {
             return EndVidModeCreate();
         }
@@ -6681,7 +8686,7 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
     }
 
     if (VideoSurface12->surface20) {
-        SDL20_free(VideoSurface12->pixels);
+        FreeSurfacePixels(VideoSurface12->pixels);
     } else {
         CreateVideoSurface(appfmt);
         if (!VideoSurface12->surface20) {
@@ -6694,7 +8699,7 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
     VideoSurface12->pixels = VideoSurface12->surface20->pixels = NULL;
     VideoSurface12->w = VideoSurface12->surface20->w = width;
     VideoSurface12->h = VideoSurface12->surface20->h = height;
-    VideoSurface12->pitch = VideoSurface12->surface20->pitch = width * SDL_BYTESPERPIXEL(appfmt);
+    VideoSurface12->pitch = VideoSurface12->surface20->pitch = SurfacePitch12(width, SDL_BYTESPERPIXEL(appfmt));
     SDL_SetClipRect(VideoSurface12, NULL);
 
     if (flags12 & SDL12_FULLSCREEN) {
@@ -6714,18 +8719,27 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
         SDL_assert(!VideoRenderer20);
 
         if (!VideoGLContext20) {
+            phase_start = BeginStartupPhase();
             VideoGLContext20 = SDL20_GL_CreateContext(VideoWindow20);
+            EndStartupPhase(STARTUP_PHASE_GL_CONTEXT, phase_start);  /* record it even if it failed; slow failures are worth knowing about. */
             if (!VideoGLContext20) {
                 return EndVidModeCreate();
             }
+
+            phase_start = BeginStartupPhase();
             LoadOpenGLFunctions();
+            EndStartupPhase(STARTUP_PHASE_GL_FUNCTIONS, phase_start);
         }
 
         VideoSurface12->flags |= SDL12_OPENGL;
 
         /* Try to set up a logical scaling */
         if (use_gl_scaling) {
-            if (!InitializeOpenGLScaling(width, height)) {
+            SDL_bool scaling_okay;
+            phase_start = BeginStartupPhase();
+            scaling_okay = InitializeOpenGLScaling(width, height);
+            EndStartupPhase(STARTUP_PHASE_GL_SCALING, phase_start);
+            if (!scaling_okay) {
                 const SDL_bool was_fullscreen = ((fullscreen_flags20 & SDL_WINDOW_FULLSCREEN_DESKTOP) != 0) ? SDL_TRUE : SDL_FALSE;
                 window_size_scaling = 1.0f;
                 use_gl_scaling = SDL_FALSE;
@@ -6755,7 +8769,7 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
             OpenGLFuncs.glBindTexture(GL_TEXTURE_2D, OpenGLBlitTexture);
             OpenGLFuncs.glTexImage2D(GL_TEXTURE_2D, 0, (pixsize == 4) ? GL_RGBA : GL_RGB, VideoSurface12->w, VideoSurface12->h, 0, glfmt, gltype, NULL);
 
-            VideoSurface12->surface20->pixels = SDL20_malloc(height * VideoSurface12->pitch);
+            VideoSurface12->surface20->pixels = AllocSurfacePixels(((size_t) height) * ((size_t) VideoSurface12->pitch));
             VideoSurface12->pixels = VideoSurface12->surface20->pixels;
             if (!VideoSurface12->pixels) {
                 SDL20_OutOfMemory();
@@ -6765,7 +8779,7 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
             VideoSurface12->flags |= SDL12_OPENGLBLIT;
         }
 
-        if (vsync_env) {
+        if (have_vsync_env) {
             SDL20_GL_SetSwapInterval(SDL20_atoi(vsync_env));
         } else {
             SDL20_GL_SetSwapInterval(SwapInterval);
@@ -6774,8 +8788,10 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
     } else {
         /* always use a renderer for non-OpenGL windows. */
         const char *old_scale_quality = SDL20_GetHint(SDL_HINT_RENDER_SCALE_QUALITY);
-        const SDL_bool want_vsync = (vsync_env && SDL20_atoi(vsync_env)) ? SDL_TRUE : SDL_FALSE;
+        const SDL_bool want_vsync = (have_vsync_env && SDL20_atoi(vsync_env)) ? SDL_TRUE : SDL_FALSE;
         SDL_RendererInfo rinfo;
+        Uint32 texfmt;
+        SDL_bool convert_screen;
         SDL_assert(!VideoGLContext20);  /* either a new window or we destroyed all this */
 
         if (!VideoRendererLock) {
@@ -6785,6 +8801,7 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
             }
         }
 
+        phase_start = BeginStartupPhase();
         if (!VideoRenderer20 && want_vsync) {
             VideoRenderer20 = SDL20_CreateRenderer(VideoWindow20, -1, SDL_RENDERER_ACCELERATED|SDL_RENDERER_PRESENTVSYNC);
         }
@@ -6794,6 +8811,7 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
         if (!VideoRenderer20) {
             VideoRenderer20 = SDL20_CreateRenderer(VideoWindow20, -1, 0);
         }
+        EndStartupPhase(STARTUP_PHASE_CREATE_RENDERER, phase_start);
         if (!VideoRenderer20) {
             return EndVidModeCreate();
         }
@@ -6812,13 +8830,36 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
             return EndVidModeCreate();
         }
 
+        texfmt = FindScreenTextureFormat(&rinfo, appfmt);
+        convert_screen = (texfmt == SDL_PIXELFORMAT_UNKNOWN) ? SDL_TRUE : SDL_FALSE;
+        if (convert_screen) {
+            texfmt = rinfo.texture_formats[0];
+        }
+
+        if (WantDebugLogging) {
+            SDL20_Log("Screen is %s, texture is %s (%s)", SDL20_GetPixelFormatName(appfmt), SDL20_GetPixelFormatName(texfmt),
+                      convert_screen ? "converting every update" : (texfmt == appfmt) ? "exact match" : "copied as-is");
+        }
+
+        if (VideoTexture20) {  /* app changed bpp without us needing a new window? Might need a different texture. */
+            Uint32 current = SDL_PIXELFORMAT_UNKNOWN;
+            if ((SDL20_QueryTexture(VideoTexture20, &current, NULL, NULL, NULL) < 0) || (current != texfmt)) {
+                SDL20_DestroyTexture(VideoTexture20);
+                VideoTexture20 = NULL;
+            }
+        }
+
         if (!VideoTexture20) {
             SDL20_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, WantScaleMethodNearest ? "0" : "1");
-            VideoTexture20 = SDL20_CreateTexture(VideoRenderer20, rinfo.texture_formats[0], SDL_TEXTUREACCESS_STREAMING, width, height);
+            phase_start = BeginStartupPhase();
+            VideoTexture20 = SDL20_CreateTexture(VideoRenderer20, texfmt, SDL_TEXTUREACCESS_STREAMING, width, height);
             SDL20_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, old_scale_quality);
+            EndStartupPhase(STARTUP_PHASE_CREATE_TEXTURE, phase_start);
             if (!VideoTexture20) {
                 return EndVidModeCreate();
             }
+            /* if this is an alpha format standing in for an XRGB screen, the unused byte must not be treated as alpha. */
+            SDL20_SetTextureBlendMode(VideoTexture20, SDL_BLENDMODE_NONE);
         }
 
         /* clear the texture for (re)use */
@@ -6831,21 +8872,21 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
         }
 
         /* don't need conversion, or need to change the conversion surface's format? Nuke the existing surface (and maybe rebuild it later). */
-        if (VideoConvertSurface20 && ((rinfo.texture_formats[0] == appfmt) || (rinfo.texture_formats[0] != VideoConvertSurface20->format->format))) {
+        if (VideoConvertSurface20 && (!convert_screen || (texfmt != VideoConvertSurface20->format->format))) {
             SDL20_FreeSurface(VideoConvertSurface20);
             VideoConvertSurface20 = NULL;
         }
 
-        if (rinfo.texture_formats[0] != appfmt) {
+        if (convert_screen) {
             /* need to convert between app's format and texture format */
-            VideoConvertSurface20 = CreateNullPixelSurface20(width, height, rinfo.texture_formats[0]);
+            VideoConvertSurface20 = CreateNullPixelSurface20(width, height, texfmt);
             if (!VideoConvertSurface20) {
                 return EndVidModeCreate();
             }
         }
 
         VideoSurface12->flags &= ~SDL12_OPENGL;
-        VideoSurface12->surface20->pixels = SDL20_calloc(height, VideoSurface12->pitch);
+        VideoSurface12->surface20->pixels = AllocSurfacePixels(((size_t) height) * ((size_t) VideoSurface12->pitch));
         VideoSurface12->pixels = VideoSurface12->surface20->pixels;
         if (!VideoSurface12->pixels) {
             SDL20_OutOfMemory();
@@ -6877,6 +8918,19 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
     VideoSurfaceLastPresentTicks = 0;
     VideoSurfaceUpdatedInBackgroundThread = SDL_FALSE;
 
+    VideoSurface12->flags &= ~SDL12_HWSURFACE;
+    if (WantHardwareBlits && (flags12 & SDL12_HWSURFACE) && ((flags12 & SDL12_OPENGL) == 0) && !VideoConvertSurface20 &&
+        (VideoSurface12->format->BitsPerPixel != 8) && !VideoSurface12->format->Amask) {
+        VideoSurfaceHardwareBlits = SDL_TRUE;
+        VideoSurface12->flags |= SDL12_HWSURFACE;  /* so SDL_MUSTLOCK() is true, and apps lock the screen before touching it. */
+    }
+
+    RecheckWindowSurfacePresent();
+
+    if (WantDebugLogging && ((flags12 & SDL12_OPENGL) == 0)) {
+        SDL20_Log("Presenting the screen %s", VideoWindowSurfacePresent ? "straight to the window surface" : "through the renderer");
+    }
+
     SDL20_RaiseWindow(VideoWindow20);
 
     UpdateInputGrab();
@@ -6895,10 +8949,15 @@ SetVideoModeImpl(int width, int height, int bpp, Uint32 flags12)
 DECLSPEC12 SDL12_Surface * SDLCALL
 SDL_SetVideoMode(int width, int height, int bpp, Uint32 flags12)
 {
+    const Uint64 phase_start = BeginStartupPhase();
     SDL12_Surface *retval;
     SetVideoModeInProgress = SDL_TRUE;
+    DiscardDisplayList();  /* whatever was on the old screen is gone. */
+    VideoSurfaceHardwareBlits = SDL_FALSE;
+    VideoWindowSurfacePresent = SDL_FALSE;
     retval = SetVideoModeImpl(width, height, bpp, flags12);
     SetVideoModeInProgress = SDL_FALSE;
+    EndStartupPhase(STARTUP_PHASE_SET_VIDEO_MODE, phase_start);
     return retval;
 }
 
@@ -6915,8 +8974,19 @@ SDL_GetVideoSurface(void)
     return VideoSurface12;
 }
 
+/* Most alpha blits in a game's hot loop are small sprites, so we save their
+   destination alpha on the stack and only go to the heap for big blits. */
+#define DEST_ALPHA_STACK_SIZE 4096
+
+typedef struct SavedDestAlpha
+{
+    SDL_Rect rect;
+    Uint8 *alpha;
+    Uint8 stackbuf[DEST_ALPHA_STACK_SIZE];
+} SavedDestAlpha;
+
 static int
-SaveDestAlpha(SDL12_Surface *src12, SDL12_Surface *dst12, SDL_Rect *dstrect20, Uint8 **retval)
+SaveDestAlpha(SDL12_Surface *src12, const SDL12_Rect *srcrect12, SDL12_Surface *dst12, const SDL_Rect *dstrect20, SavedDestAlpha *saved)
 {
     /* The 1.2 docs say this:
      * RGBA->RGBA:
@@ -6926,29 +8996,56 @@ SaveDestAlpha(SDL12_Surface *src12, SDL12_Surface *dst12, SDL_Rect *dstrect20, U
      *
      * In SDL2, we change the destination alpha. We have to save it off in this case, which sucks.
      */
-    Uint8 *dstalpha = NULL;
     const SDL_bool save_dstalpha = (PreserveDestinationAlpha && (src12->flags & SDL12_SRCALPHA) && dst12->format->Amask && ((src12->format->alpha != 255) || src12->format->Amask)) ? SDL_TRUE : SDL_FALSE;
+    SDL_Rect *rect = &saved->rect;
+    SDL_Rect bounds;
+
+    saved->alpha = NULL;
+
+    if (!save_dstalpha) {
+        return 0;
+    }
+
+    /* The blit can't touch more than the source's size, starting at the
+       destination position, so only save that much, not everything to the
+       edge of the surface. Don't clip this against the destination's clip
+       rect, though: SDL_LowerBlit doesn't, so it can write outside of it. */
+    SDL20_memcpy(rect, dstrect20, sizeof (SDL_Rect));
+    rect->w = SDL_min(rect->w, src12->w);
+    rect->h = SDL_min(rect->h, src12->h);
+    if (srcrect12) {
+        rect->w = SDL_min(rect->w, (int) srcrect12->w);
+        rect->h = SDL_min(rect->h, (int) srcrect12->h);
+    }
 
-    if (save_dstalpha && (dstrect20->w > 0) && (dstrect20->h > 0)) {
+    bounds.x = bounds.y = 0;
+    bounds.w = dst12->w;
+    bounds.h = dst12->h;
+
+    if ((rect->w > 0) && (rect->h > 0) && SDL20_IntersectRect(rect, &bounds, rect)) {
         const Uint32 amask = dst12->format->Amask;
         const Uint32 ashift = dst12->format->Ashift;
         const Uint16 pitch = dst12->pitch;
+        const size_t len = ((size_t) rect->w) * ((size_t) rect->h);
         Uint8 *dptr;
         int x, y, w, h;
 
-        w = dstrect20->w;
-        h = dstrect20->h;
+        w = rect->w;
+        h = rect->h;
 
-        dstalpha = (Uint8 *) SDL20_malloc(w * h);
-        if (!dstalpha) {
-            *retval = NULL;
-            return SDL20_OutOfMemory();
+        if (len <= sizeof (saved->stackbuf)) {
+            dptr = saved->stackbuf;
+        } else {
+            dptr = (Uint8 *) SDL20_malloc(len);
+            if (!dptr) {
+                return SDL20_OutOfMemory();
+            }
         }
-        dptr = dstalpha;
+        saved->alpha = dptr;
 
         if (dst12->format->BytesPerPixel == 2) {
             const Uint16 *sptr = (const Uint16 *) dst12->pixels;
-            sptr += ((dst12->pitch / 2) * dstrect20->y) + dstrect20->x;
+            sptr += ((dst12->pitch / 2) * rect->y) + rect->x;
             for (y = 0; y < h; y++) {
                 for (x = 0; x < w; x++) {
                     *(dptr++) = (Uint8) ((sptr[x] & amask) >> ashift);
@@ -6957,7 +9054,7 @@ SaveDestAlpha(SDL12_Surface *src12, SDL12_Surface *dst12, SDL_Rect *dstrect20, U
             }
         } else if (dst12->format->BytesPerPixel == 4) {
             const Uint32 *sptr = (const Uint32 *) dst12->pixels;
-            sptr += ((dst12->pitch / 4) * dstrect20->y) + dstrect20->x;
+            sptr += ((dst12->pitch / 4) * rect->y) + rect->x;
             for (y = 0; y < h; y++) {
                 for (x = 0; x < w; x++) {
                     *(dptr++) = (Uint8) ((sptr[x] & amask) >> ashift);
@@ -6969,46 +9066,396 @@ SaveDestAlpha(SDL12_Surface *src12, SDL12_Surface *dst12, SDL_Rect *dstrect20, U
         }
     }
 
-    *retval = dstalpha;
     return 0;
 }
 
-static void
-RestoreDestAlpha(SDL12_Surface *dst12, Uint8 *dstalpha, const SDL_Rect *dstrect20)
+static void
+RestoreDestAlpha(SDL12_Surface *dst12, SavedDestAlpha *saved)
+{
+    if (saved->alpha) {
+        const Uint8 *sptr = saved->alpha;
+        const SDL_Rect *rect = &saved->rect;
+        const Uint32 amask = dst12->format->Amask;
+        const Uint32 ashift = dst12->format->Ashift;
+        const Uint16 pitch = dst12->pitch;
+        int x, y, w, h;
+
+        w = rect->w;
+        h = rect->h;
+
+        if (dst12->format->BytesPerPixel == 2) {
+            Uint16 *dptr = (Uint16 *) dst12->pixels;
+            dptr += ((dst12->pitch / 2) * rect->y) + rect->x;
+            for (y = 0; y < h; y++) {
+                for (x = 0; x < w; x++) {
+                    dptr[x] = (Uint16) ((dptr[x] & ~amask) | ((((Uint16) *(sptr++)) << ashift) & amask));
+                }
+                dptr = (Uint16 *) (((Uint8 *) dptr) + pitch);
+            }
+        } else if (dst12->format->BytesPerPixel == 4) {
+            Uint32 *dptr = (Uint32 *) dst12->pixels;
+            dptr += ((dst12->pitch / 4) * rect->y) + rect->x;
+            for (y = 0; y < h; y++) {
+                for (x = 0; x < w; x++) {
+                    dptr[x] = (dptr[x] & ~amask) | ((((Uint32) *(sptr++)) << ashift) & amask);
+                }
+                dptr = (Uint32 *) (((Uint8 *) dptr) + pitch);
+            }
+        } else {
+            SDL_assert(!"Unhandled dest alpha");
+        }
+
+        if (saved->alpha != saved->stackbuf) {
+            SDL20_free(saved->alpha);
+        }
+        saved->alpha = NULL;
+    }
+}
+
+/* When SaveDestAlpha would have to step in, and the source and destination
+   are both ARGB8888, both ABGR8888 or both RGBA4444 (which covers what
+   SDL_DisplayFormatAlpha hands out), we do the blend ourselves instead, in
+   one pass that blends the RGB and never touches the destination alpha.
+
+   The RGB has to come out exactly like SDL2's, though, and SDL2's blend
+   math isn't one thing: 32-bit pixels go through a C path or an MMX path
+   (depending on how SDL2 was built and what CPU we're on), other formats go
+   through a generic path, and that one has changed how it widens 4-bit
+   channels and how it rounds over the years. The version number can't tell
+   us about the MMX path, so the first time we see each of these formats, we
+   have SDL2 blend a test pattern and keep whichever of our kernels gets the
+   same RGB for every pixel. If none of them do, that format just stays on
+   the save/restore path. */
+typedef enum DestAlphaMath
+{
+    DESTALPHA_MATH_UNKNOWN = 0,  /* haven't asked SDL2 about this format yet. */
+    DESTALPHA_MATH_NONE,  /* nothing we have matches SDL2, use SaveDestAlpha. */
+    DESTALPHA_MATH_PACKED,  /* SDL2's C path for 32-bit: d + ((s - d) * a >> 8), red and blue in one multiply. */
+    DESTALPHA_MATH_SPLIT,  /* SDL2's MMX path: (s * a >> 8) + (d * (255 - a) >> 8). */
+    DESTALPHA_MATH_DIV255,  /* SDL2's generic path: d + (s - d) * a / 255, truncated. */
+    DESTALPHA_MATH_ROUNDED  /* the generic path rounded to nearest, in case the SDL2 we're on does that. */
+} DestAlphaMath;
+
+/* or'd into the math for 4-bit formats if SDL2 widens channels with SDL_expand_byte (v * 17) instead of (v << 4). */
+#define DESTALPHA_EXPAND_REPLICATE 0x100
+
+#define DESTALPHA_PROBE_W 256
+#define DESTALPHA_PROBE_H 64
+
+static SDL_atomic_t DestAlphaFormatMath[3];  /* ARGB8888, ABGR8888, RGBA4444 */
+static SDL_SpinLock DestAlphaProbeLock = 0;
+
+static SDL_INLINE Uint32
+DestAlphaBlendChannel(const int math, const Uint32 s, const Uint32 d, const Uint32 a)
+{
+    int x;
+    switch (math) {
+        case DESTALPHA_MATH_SPLIT:
+            return ((s * a) >> 8) + ((d * (255 - a)) >> 8);
+        case DESTALPHA_MATH_DIV255:
+            return (Uint32) (((((int) s - (int) d) * (int) a) / 255) + (int) d);
+        case DESTALPHA_MATH_ROUNDED:
+            x = ((((int) s - (int) d) * (int) a) + ((int) (d << 8) - (int) d)) + 1;
+            x += x >> 8;
+            return (Uint32) (x >> 8);
+        default: break;
+    }
+    SDL_assert(!"Unhandled dest alpha math");
+    return d;
+}
+
+/* alpha is the top byte of both ARGB8888 and ABGR8888, and the other three channels are blended the same way. */
+static SDL_INLINE Uint32
+DestAlphaBlend32(const int math, const Uint32 s, const Uint32 d)
+{
+    const Uint32 alpha = s >> 24;
+    Uint32 retval;
+    int shift;
+
+    if (alpha == 0) {
+        return d;
+    } else if (alpha == 255) {
+        return (s & 0x00FFFFFF) | (d & 0xFF000000);  /* SDL2 copies these pixels outright. */
+    } else if (math == DESTALPHA_MATH_PACKED) {
+        Uint32 rb = d & 0xFF00FF;
+        Uint32 g = d & 0xFF00;
+        rb = (rb + (((s & 0xFF00FF) - rb) * alpha >> 8)) & 0xFF00FF;
+        g = (g + (((s & 0xFF00) - g) * alpha >> 8)) & 0xFF00;
+        return rb | g | (d & 0xFF000000);
+    }
+
+    retval = d & 0xFF000000;
+    for (shift = 0; shift < 24; shift += 8) {
+        retval |= DestAlphaBlendChannel(math, (s >> shift) & 0xFF, (d >> shift) & 0xFF, alpha) << shift;
+    }
+    return retval;
+}
+
+/* RGBA4444: widen to 8 bits, blend, and truncate back, like SDL2's generic path. */
+static SDL_INLINE Uint16
+DestAlphaBlend4444(const int math, const Uint8 *expand, const Uint16 s, const Uint16 d)
+{
+    const Uint32 alpha = expand[s & 0xF];
+    Uint16 retval;
+    int shift;
+
+    if ((s & 0xF) == 0) {
+        return d;
+    }
+
+    retval = d & 0xF;
+    for (shift = 4; shift < 16; shift += 4) {
+        retval |= (Uint16) ((DestAlphaBlendChannel(math, expand[(s >> shift) & 0xF], expand[(d >> shift) & 0xF], alpha) >> 4) << shift);
+    }
+    return retval;
+}
+
+static void
+DestAlphaBlit32(const int math, const Uint8 *srcrow, const int srcpitch, Uint8 *dstrow, const int dstpitch, const int w, int h)
+{
+    int x;
+
+    /* switch per row, so each loop gets its own copy of the blend with the math inlined. */
+    while (h--) {
+        const Uint32 *s = (const Uint32 *) srcrow;
+        Uint32 *d = (Uint32 *) dstrow;
+        switch (math) {
+            case DESTALPHA_MATH_PACKED:
+                for (x = 0; x < w; x++) { d[x] = DestAlphaBlend32(DESTALPHA_MATH_PACKED, s[x], d[x]); }
+                break;
+            case DESTALPHA_MATH_SPLIT:
+                for (x = 0; x < w; x++) { d[x] = DestAlphaBlend32(DESTALPHA_MATH_SPLIT, s[x], d[x]); }
+                break;
+            case DESTALPHA_MATH_DIV255:
+                for (x = 0; x < w; x++) { d[x] = DestAlphaBlend32(DESTALPHA_MATH_DIV255, s[x], d[x]); }
+                break;
+            case DESTALPHA_MATH_ROUNDED:
+                for (x = 0; x < w; x++) { d[x] = DestAlphaBlend32(DESTALPHA_MATH_ROUNDED, s[x], d[x]); }
+                break;
+            default: SDL_assert(!"Unhandled dest alpha math"); break;
+        }
+        srcrow += srcpitch;
+        dstrow += dstpitch;
+    }
+}
+
+static void
+DestAlphaBlit4444(const int math, const Uint8 *srcrow, const int srcpitch, Uint8 *dstrow, const int dstpitch, const int w, int h)
+{
+    Uint8 expand[16];
+    int x;
+
+    for (x = 0; x < 16; x++) {
+        expand[x] = (Uint8) ((math & DESTALPHA_EXPAND_REPLICATE) ? (x * 17) : (x << 4));
+    }
+
+    while (h--) {
+        const Uint16 *s = (const Uint16 *) srcrow;
+        Uint16 *d = (Uint16 *) dstrow;
+        if ((math & ~DESTALPHA_EXPAND_REPLICATE) == DESTALPHA_MATH_DIV255) {
+            for (x = 0; x < w; x++) { d[x] = DestAlphaBlend4444(DESTALPHA_MATH_DIV255, expand, s[x], d[x]); }
+        } else {
+            for (x = 0; x < w; x++) { d[x] = DestAlphaBlend4444(DESTALPHA_MATH_ROUNDED, expand, s[x], d[x]); }
+        }
+        srcrow += srcpitch;
+        dstrow += dstpitch;
+    }
+}
+
+/* Have SDL2 blend a test pattern in this format, and see which of our kernels gets the same RGB. */
+static int
+ProbeDestAlphaMath(const Uint32 format20)
+{
+    static const int candidates32[] = {
+        DESTALPHA_MATH_PACKED, DESTALPHA_MATH_SPLIT, DESTALPHA_MATH_DIV255, DESTALPHA_MATH_ROUNDED
+    };
+    static const int candidates4444[] = {
+        DESTALPHA_MATH_DIV255 | DESTALPHA_EXPAND_REPLICATE, DESTALPHA_MATH_DIV255,
+        DESTALPHA_MATH_ROUNDED | DESTALPHA_EXPAND_REPLICATE, DESTALPHA_MATH_ROUNDED
+    };
+    const SDL_bool is32 = (format20 != SDL_PIXELFORMAT_RGBA4444) ? SDL_TRUE : SDL_FALSE;
+    const int bpp = is32 ? 32 : 16;
+    const int *candidates = is32 ? candidates32 : candidates4444;
+    const int numcandidates = is32 ? (int) SDL_arraysize(candidates32) : (int) SDL_arraysize(candidates4444);
+    SDL_Surface *src = SDL20_CreateRGBSurfaceWithFormat(0, DESTALPHA_PROBE_W, DESTALPHA_PROBE_H, bpp, format20);
+    SDL_Surface *dst = SDL20_CreateRGBSurfaceWithFormat(0, DESTALPHA_PROBE_W, DESTALPHA_PROBE_H, bpp, format20);
+    Uint8 *orig = NULL;
+    int retval = DESTALPHA_MATH_NONE;
+    Uint32 seed = 0x12345678;
+    int i, x, y;
+
+    if (!src || !dst || (SDL20_SetSurfaceBlendMode(src, SDL_BLENDMODE_BLEND) < 0)) {
+        goto done;
+    }
+
+    /* 32-bit gets every alpha value against random colors. 4-bit channels
+       are few enough that every channel gets every source/dest/alpha combo. */
+    for (y = 0; y < DESTALPHA_PROBE_H; y++) {
+        Uint8 *srow = ((Uint8 *) src->pixels) + (y * src->pitch);
+        Uint8 *drow = ((Uint8 *) dst->pixels) + (y * dst->pitch);
+        for (x = 0; x < DESTALPHA_PROBE_W; x++) {
+            Uint32 r1, r2;
+            seed = (seed * 1103515245) + 12345;
+            r1 = seed;
+            seed = (seed * 1103515245) + 12345;
+            r2 = seed;
+            if (is32) {
+                ((Uint32 *) srow)[x] = (((Uint32) x) << 24) | (r1 >> 8);
+                ((Uint32 *) drow)[x] = r2;
+            } else {
+                const Uint32 idx = (Uint32) ((y * DESTALPHA_PROBE_W) + x);
+                const Uint32 sc = (idx >> 4) & 0xF;
+                const Uint32 dc = (idx >> 8) & 0xF;
+                ((Uint16 *) srow)[x] = (Uint16) ((sc << 12) | (((sc + 5) & 0xF) << 8) | (((sc + 10) & 0xF) << 4) | (idx & 0xF));
+                ((Uint16 *) drow)[x] = (Uint16) ((dc << 12) | (((dc + 3) & 0xF) << 8) | (((dc + 9) & 0xF) << 4) | ((r2 >> 16) & 0xF));
+            }
+        }
+    }
+
+    orig = (Uint8 *) SDL20_malloc(dst->pitch * DESTALPHA_PROBE_H);
+    if (!orig) {
+        goto done;
+    }
+    SDL20_memcpy(orig, dst->pixels, dst->pitch * DESTALPHA_PROBE_H);
+
+    if (SDL20_UpperBlit(src, NULL, dst, NULL) < 0) {
+        goto done;
+    }
+
+    for (i = 0; (i < numcandidates) && (retval == DESTALPHA_MATH_NONE); i++) {
+        const int math = candidates[i];
+        Uint8 expand[16];
+        SDL_bool matches = SDL_TRUE;
+
+        for (x = 0; x < 16; x++) {
+            expand[x] = (Uint8) ((math & DESTALPHA_EXPAND_REPLICATE) ? (x * 17) : (x << 4));
+        }
+
+        for (y = 0; matches && (y < DESTALPHA_PROBE_H); y++) {
+            const Uint8 *srow = ((const Uint8 *) src->pixels) + (y * src->pitch);
+            const Uint8 *orow = orig + (y * dst->pitch);
+            const Uint8 *drow = ((const Uint8 *) dst->pixels) + (y * dst->pitch);
+            for (x = 0; matches && (x < DESTALPHA_PROBE_W); x++) {
+                if (is32) {
+                    const Uint32 want = ((const Uint32 *) drow)[x];
+                    const Uint32 got = DestAlphaBlend32(math, ((const Uint32 *) srow)[x], ((const Uint32 *) orow)[x]);
+                    matches = ((want & 0x00FFFFFF) == (got & 0x00FFFFFF)) ? SDL_TRUE : SDL_FALSE;
+                } else {
+                    const Uint16 want = ((const Uint16 *) drow)[x];
+                    const Uint16 got = DestAlphaBlend4444(math & ~DESTALPHA_EXPAND_REPLICATE, expand, ((const Uint16 *) srow)[x], ((const Uint16 *) orow)[x]);
+                    matches = ((want & 0xFFF0) == (got & 0xFFF0)) ? SDL_TRUE : SDL_FALSE;
+                }
+            }
+        }
+
+        if (matches) {
+            retval = math;
+        }
+    }
+
+done:
+    SDL20_free(orig);
+    if (src) {
+        SDL20_FreeSurface(src);
+    }
+    if (dst) {
+        SDL20_FreeSurface(dst);
+    }
+    return retval;
+}
+
+static int
+GetDestAlphaMath(const Uint32 format20)
+{
+    SDL_atomic_t *cached;
+    int math;
+
+    switch (format20) {
+        case SDL_PIXELFORMAT_ARGB8888: cached = &DestAlphaFormatMath[0]; break;
+        case SDL_PIXELFORMAT_ABGR8888: cached = &DestAlphaFormatMath[1]; break;
+        case SDL_PIXELFORMAT_RGBA4444: cached = &DestAlphaFormatMath[2]; break;
+        default: return DESTALPHA_MATH_NONE;
+    }
+
+    math = SDL20_AtomicGet(cached);
+    if (math == DESTALPHA_MATH_UNKNOWN) {
+        SDL20_AtomicLock(&DestAlphaProbeLock);
+        math = SDL20_AtomicGet(cached);
+        if (math == DESTALPHA_MATH_UNKNOWN) {
+            math = ProbeDestAlphaMath(format20);
+            SDL20_AtomicSet(cached, math);
+            if (WantDebugLogging) {
+                SDL20_Log("Destination alpha blend for %s: %s", SDL20_GetPixelFormatName(format20),
+                          (math == DESTALPHA_MATH_NONE) ? "SDL2, with save/restore" : "our own kernel");
+            }
+        }
+        SDL20_AtomicUnlock(&DestAlphaProbeLock);
+    }
+    return math;
+}
+
+/* srcrect and dstrect are already clipped, like SDL_LowerBlit wants.
+   Returns SDL_FALSE if this should go through SaveDestAlpha and SDL2. */
+static SDL_bool
+DestAlphaLowerBlit(SDL12_Surface *src12, const SDL_Rect *srcrect, SDL12_Surface *dst12, const SDL_Rect *dstrect)
+{
+    SDL_Surface *src = src12->surface20;
+    SDL_Surface *dst = dst12->surface20;
+    const Uint32 format20 = dst->format->format;
+    SDL_BlendMode blendmode = SDL_BLENDMODE_NONE;
+    Uint8 alphamod = 255;
+    const Uint8 *srcrow;
+    Uint8 *dstrow;
+    int math;
+
+    if (!PreserveDestinationAlpha || !GetHintConfig()->dest_alpha_kernels) {
+        return SDL_FALSE;
+    } else if (((src12->flags & SDL12_SRCALPHA) == 0) || !src12->format->Amask || (src->format->format != format20) || (src == dst)) {
+        return SDL_FALSE;
+    } else if ((src->flags & SDL_RLEACCEL) || src->locked || dst->locked) {
+        return SDL_FALSE;  /* RLE has its own blitters, and SDL2 reports the locked error. */
+    } else if ((SDL20_GetSurfaceBlendMode(src, &blendmode) < 0) || (blendmode != SDL_BLENDMODE_BLEND)) {
+        return SDL_FALSE;
+    } else if ((SDL20_GetSurfaceAlphaMod(src, &alphamod) < 0) || (alphamod != 255)) {
+        return SDL_FALSE;
+    } else if (src12->flags & SDL12_SRCCOLORKEY) {
+        return SDL_FALSE;  /* SDL2 might have a colorkey on this, which means a different SDL2 blitter. */
+    }
+
+    math = GetDestAlphaMath(format20);
+    if (math == DESTALPHA_MATH_NONE) {
+        return SDL_FALSE;
+    }
+
+    srcrow = ((const Uint8 *) src->pixels) + (srcrect->y * src->pitch) + (srcrect->x * src->format->BytesPerPixel);
+    dstrow = ((Uint8 *) dst->pixels) + (dstrect->y * dst->pitch) + (dstrect->x * dst->format->BytesPerPixel);
+    if (format20 == SDL_PIXELFORMAT_RGBA4444) {
+        DestAlphaBlit4444(math, srcrow, src->pitch, dstrow, dst->pitch, dstrect->w, dstrect->h);
+    } else {
+        DestAlphaBlit32(math, srcrow, src->pitch, dstrow, dst->pitch, dstrect->w, dstrect->h);
+    }
+    return SDL_TRUE;
+}
+
+/* Returns SDL_FALSE if this should go through SaveDestAlpha and SDL2. */
+static SDL_bool
+DestAlphaUpperBlit(SDL12_Surface *src12, const SDL_Rect *srcrect, SDL12_Surface *dst12, SDL_Rect *dstrect, int *retval)
 {
-    if (dstalpha) {
-        const Uint8 *sptr = dstalpha;
-        const Uint32 amask = dst12->format->Amask;
-        const Uint32 ashift = dst12->format->Ashift;
-        const Uint16 pitch = dst12->pitch;
-        int x, y, w, h;
+    SDL_Rect sr, dr;
 
-        w = dstrect20->w;
-        h = dstrect20->h;
+    if (!src12->format->Amask) {
+        return SDL_FALSE;  /* the common case, get out quickly. */
+    } else if (!ClipUpperBlit(src12->surface20, srcrect, dst12->surface20, dstrect, &sr, &dr)) {
+        return SDL_FALSE;  /* SDL2 will figure out the empty blit. */
+    } else if (!DestAlphaLowerBlit(src12, &sr, dst12, &dr)) {
+        return SDL_FALSE;
+    }
 
-        if (dst12->format->BytesPerPixel == 2) {
-            Uint16 *dptr = (Uint16 *) dst12->pixels;
-            dptr += ((dst12->pitch / 2) * dstrect20->y) + dstrect20->x;
-            for (y = 0; y < h; y++) {
-                for (x = 0; x < w; x++) {
-                    dptr[x] = (Uint16) ((dptr[x] & ~amask) | ((((Uint16) *(sptr++)) << ashift) & amask));
-                }
-                dptr = (Uint16 *) (((Uint8 *) dptr) + pitch);
-            }
-        } else if (dst12->format->BytesPerPixel == 4) {
-            Uint32 *dptr = (Uint32 *) dst12->pixels;
-            dptr += ((dst12->pitch / 4) * dstrect20->y) + dstrect20->x;
-            for (y = 0; y < h; y++) {
-                for (x = 0; x < w; x++) {
-                    dptr[x] = (dptr[x] & ~amask) | ((((Uint32) *(sptr++)) << ashift) & amask);
-                }
-                dptr = (Uint32 *) (((Uint8 *) dptr) + pitch);
-            }
-        } else {
-            SDL_assert(!"Unhandled dest alpha");
-        }
-        SDL20_free(dstalpha);
+    *retval = 0;
+    if (dstrect) {
+        SDL20_memcpy(dstrect, &dr, sizeof (SDL_Rect));
     }
+    return SDL_TRUE;
 }
 
 static void
@@ -7035,7 +9482,7 @@ PrepBlitDestRect(SDL_Rect *dstrect20, SDL12_Surface *dst12, const SDL12_Rect *ds
 DECLSPEC12 int SDLCALL
 SDL_UpperBlit(SDL12_Surface *src12, SDL12_Rect *srcrect12, SDL12_Surface *dst12, SDL12_Rect *dstrect12)
 {
-    Uint8 *dstalpha;
+    SavedDestAlpha dstalpha;
     SDL_Rect srcrect20, dstrect20;
     int retval;
 
@@ -7046,18 +9493,47 @@ SDL_UpperBlit(SDL12_Surface *src12, SDL12_Rect *srcrect12, SDL12_Surface *dst12,
         return SDL20_SetError("SDL_UpperBlit: passed a surface with NULL pixels");
     }
 
+    if (RecordHardwareBlit(src12, srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
+                           dst12, dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL,
+                           &retval)) {
+        if (dstrect12) {
+            Rect20to12(&dstrect20, dstrect12);
+        }
+        return retval;
+    }
+
+    SurfaceWillBeRead12(src12);
+    SurfaceWillChange12(dst12);
+
+    if (DestAlphaUpperBlit(src12, srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
+                           dst12, dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL,
+                           &retval)) {
+        if (dstrect12) {
+            Rect20to12(&dstrect20, dstrect12);
+        }
+        return retval;
+    }
+
     PrepBlitDestRect(&dstrect20, dst12, dstrect12);
 
-    if (SaveDestAlpha(src12, dst12, &dstrect20, &dstalpha) < 0) {
+    if (SaveDestAlpha(src12, srcrect12, dst12, &dstrect20, &dstalpha) < 0) {
         return -1;
     }
 
-    retval = SDL20_UpperBlit(src12->surface20,
-                             srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
-                             dst12->surface20,
-                             dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL);
+    if (PaletteMapUpperBlit(src12->surface20,
+                            srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
+                            dst12->surface20,
+                            dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL,
+                            &retval)) {
+        /* we did it ourselves with a cached palette map. */
+    } else {
+        retval = SDL20_UpperBlit(src12->surface20,
+                                 srcrect12 ? &srcrect20 : NULL,
+                                 dst12->surface20,
+                                 dstrect12 ? &dstrect20 : NULL);
+    }
 
-    RestoreDestAlpha(dst12, dstalpha, &dstrect20);
+    RestoreDestAlpha(dst12, &dstalpha);
 
     if (dstrect12) {
         Rect20to12(&dstrect20, dstrect12);
@@ -7069,22 +9545,35 @@ SDL_UpperBlit(SDL12_Surface *src12, SDL12_Rect *srcrect12, SDL12_Surface *dst12,
 DECLSPEC12 int SDLCALL
 SDL_LowerBlit(SDL12_Surface *src12, SDL12_Rect *srcrect12, SDL12_Surface *dst12, SDL12_Rect *dstrect12)
 {
-    Uint8 *dstalpha;
+    SavedDestAlpha dstalpha;
     SDL_Rect srcrect20, dstrect20;
     int retval;
 
+    SurfaceWillBeRead12(src12);
+    SurfaceWillChange12(dst12);
+
+    if (srcrect12 && dstrect12 &&
+        DestAlphaLowerBlit(src12, Rect12to20(srcrect12, &srcrect20), dst12, Rect12to20(dstrect12, &dstrect20))) {
+        return 0;
+    }
+
     PrepBlitDestRect(&dstrect20, dst12, dstrect12);
 
-    if (SaveDestAlpha(src12, dst12, &dstrect20, &dstalpha) < 0) {
+    if (SaveDestAlpha(src12, srcrect12, dst12, &dstrect20, &dstalpha) < 0) {
         return -1;
     }
 
-    retval = SDL20_LowerBlit(src12->surface20,
-                             srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
-                             dst12->surface20,
-                             dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL);
+    if (srcrect12 && dstrect12 &&
+        PaletteMapLowerBlit(src12->surface20, Rect12to20(srcrect12, &srcrect20), dst12->surface20, Rect12to20(dstrect12, &dstrect20))) {
+        retval = 0;
+    } else {
+        retval = SDL20_LowerBlit(src12->surface20,
+                                 srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
+                                 dst12->surface20,
+                                 dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL);
+    }
 
-    RestoreDestAlpha(dst12, dstalpha, &dstrect20);
+    RestoreDestAlpha(dst12, &dstalpha);
 
     if (srcrect12) {
         Rect20to12(&srcrect20, srcrect12);
@@ -7097,14 +9586,259 @@ SDL_LowerBlit(SDL12_Surface *src12, SDL12_Rect *srcrect12, SDL12_Surface *dst12,
     return retval;
 }
 
+/* Games love to SDL_SoftStretch a low-res back buffer up to the screen
+   every frame, usually by a whole number. SDL2's nearest-neighbor stretch
+   has changed its fixed-point math over the years: since 2.0.16 it samples
+   pixel centers, so dst pixel i comes from src pixel
+   ((inc / 2) + (i * inc)) >> 16, where inc is (src_len << 16) / dst_len, and
+   we can match that for any ratio. Before that it stepped from the left
+   edge, which only gives the same answer for power-of-two factors, so on
+   older SDL2s everything else goes to SDL2.
+
+   Each size pair gets a table of source columns, built once and shared
+   between threads; it's refcounted, so the lock is only held long enough
+   to grab it, and a stretch to a different size can replace it while
+   another thread is still using the old one. Big stretches get split into
+   bands of rows across the band workers, if there are any. */
+typedef struct StretchColumnTable
+{
+    SDL_atomic_t refcount;
+    int src_w;
+    int dst_w;
+    Uint16 *columns;  /* dst_w of them, right after this struct. */
+} StretchColumnTable;
+
+typedef struct StretchJob
+{
+    const SDL_Surface *src;
+    SDL_Rect srcrect;
+    SDL_Surface *dst;
+    SDL_Rect dstrect;
+    const Uint16 *columns;
+} StretchJob;
+
+static StretchColumnTable *StretchColumns = NULL;
+static SDL_SpinLock StretchColumnsLock = 0;
+
+/* Can we map dst pixels to src pixels exactly like the current SDL2 does? */
+static SDL_bool
+StretchMatchesSDL2(const int src_len, const int dst_len)
+{
+    Uint32 factor;
+
+    if (src_len > 0x7FFF) {
+        return SDL_FALSE;  /* SDL2's math overflows; let it do whatever it does. */
+    } else if (LinkedSDL2VersionInt >= SDL_VERSIONNUM(2, 0, 16)) {
+        return SDL_TRUE;
+    } else if ((dst_len % src_len) != 0) {
+        return SDL_FALSE;
+    }
+
+    /* powers of two are exact in the old stepping math, too. */
+    factor = (Uint32) (dst_len / src_len);
+    return ((factor & (factor - 1)) == 0) ? SDL_TRUE : SDL_FALSE;
+}
+
+static SDL_INLINE int
+StretchSourceIndex(const int i, const int src_len, const int dst_len)
+{
+    const Uint32 inc = (((Uint32) src_len) << 16) / ((Uint32) dst_len);
+    return (int) (((inc / 2) + (((Uint32) i) * inc)) >> 16);
+}
+
+static void
+ReleaseStretchColumns(StretchColumnTable *table)
+{
+    if (table && (SDL20_AtomicAdd(&table->refcount, -1) == 1)) {
+        SDL20_free(table);
+    }
+}
+
+/* Returns a reference the caller must ReleaseStretchColumns, or NULL if out of memory. */
+static StretchColumnTable *
+GetStretchColumns(const int src_w, const int dst_w)
+{
+    StretchColumnTable *table;
+    StretchColumnTable *old;
+    int i;
+
+    SDL20_AtomicLock(&StretchColumnsLock);
+    table = StretchColumns;
+    if (table && (table->src_w == src_w) && (table->dst_w == dst_w)) {
+        SDL20_AtomicAdd(&table->refcount, 1);
+        SDL20_AtomicUnlock(&StretchColumnsLock);
+        return table;
+    }
+    SDL20_AtomicUnlock(&StretchColumnsLock);
+
+    table = (StretchColumnTable *) SDL20_malloc(sizeof (StretchColumnTable) + (dst_w * sizeof (Uint16)));
+    if (!table) {
+        return NULL;
+    }
+    table->src_w = src_w;
+    table->dst_w = dst_w;
+    table->columns = (Uint16 *) (table + 1);
+    for (i = 0; i < dst_w; i++) {
+        table->columns[i] = (Uint16) StretchSourceIndex(i, src_w, dst_w);
+    }
+    SDL20_AtomicSet(&table->refcount, 2);  /* one for StretchColumns, one for the caller. */
+
+    SDL20_AtomicLock(&StretchColumnsLock);
+    old = StretchColumns;
+    StretchColumns = table;
+    SDL20_AtomicUnlock(&StretchColumnsLock);
+
+    ReleaseStretchColumns(old);
+    return table;
+}
+
+static void
+FreeStretchColumns(void)
+{
+    StretchColumnTable *table;
+    SDL20_AtomicLock(&StretchColumnsLock);
+    table = StretchColumns;
+    StretchColumns = NULL;
+    SDL20_AtomicUnlock(&StretchColumnsLock);
+    ReleaseStretchColumns(table);
+}
+
+/* dst rows y1 through y2 - 1, relative to job->dstrect. */
+static void
+StretchRows(const StretchJob *job, const int y1, const int y2)
+{
+    const SDL_Rect *srcrect = &job->srcrect;
+    const SDL_Rect *dstrect = &job->dstrect;
+    const int bpp = job->dst->format->BytesPerPixel;
+    const int dstpitch = job->dst->pitch;
+    const Uint16 *columns = job->columns;
+    const Uint8 *srcrow;
+    Uint8 *prevdstrow = NULL;
+    Uint8 *dstrow;
+    int prevsrcy = -1;
+    int x, y;
+
+    dstrow = ((Uint8 *) job->dst->pixels) + ((dstrect->y + y1) * dstpitch) + (dstrect->x * bpp);
+    for (y = y1; y < y2; y++, dstrow += dstpitch) {
+        const int srcy = StretchSourceIndex(y, srcrect->h, dstrect->h);
+        if (srcy == prevsrcy) {  /* same source row as last time? Just copy what we made. */
+            SDL20_memcpy(dstrow, prevdstrow, dstrect->w * bpp);
+            continue;
+        }
+
+        srcrow = ((const Uint8 *) job->src->pixels) + ((srcrect->y + srcy) * job->src->pitch) + (srcrect->x * bpp);
+        switch (bpp) {
+            case 1:
+                for (x = 0; x < dstrect->w; x++) {
+                    dstrow[x] = srcrow[columns[x]];
+                }
+                break;
+            case 2:
+                for (x = 0; x < dstrect->w; x++) {
+                    ((Uint16 *) dstrow)[x] = ((const Uint16 *) srcrow)[columns[x]];
+                }
+                break;
+            case 4:
+                for (x = 0; x < dstrect->w; x++) {
+                    ((Uint32 *) dstrow)[x] = ((const Uint32 *) srcrow)[columns[x]];
+                }
+                break;
+        }
+        prevsrcy = srcy;
+        prevdstrow = dstrow;
+    }
+}
+
+/* Returns SDL_FALSE if SDL2 should do this one. */
+static SDL_bool
+ExactSoftStretch(SDL_Surface *src, const SDL_Rect *srcrect, SDL_Surface *dst, const SDL_Rect *dstrect)
+{
+    const int bpp = dst->format->BytesPerPixel;
+    StretchColumnTable *table;
+    StretchJob stretch;
+
+    if ((src == dst) || (src->format->format != dst->format->format) || SDL_MUSTLOCK(src) || SDL_MUSTLOCK(dst)) {
+        return SDL_FALSE;
+    } else if ((bpp != 1) && (bpp != 2) && (bpp != 4)) {
+        return SDL_FALSE;
+    } else if ((srcrect->x < 0) || (srcrect->y < 0) || ((srcrect->x + srcrect->w) > src->w) || ((srcrect->y + srcrect->h) > src->h)) {
+        return SDL_FALSE;  /* let SDL2 set the error. */
+    } else if ((dstrect->x < 0) || (dstrect->y < 0) || ((dstrect->x + dstrect->w) > dst->w) || ((dstrect->y + dstrect->h) > dst->h)) {
+        return SDL_FALSE;  /* let SDL2 set the error. */
+    } else if ((srcrect->w <= 0) || (srcrect->h <= 0) || (dstrect->w <= 0) || (dstrect->h <= 0) || (dstrect->w > 0xFFFF) || (dstrect->h > 0xFFFF)) {
+        return SDL_FALSE;
+    } else if (!StretchMatchesSDL2(srcrect->w, dstrect->w) || !StretchMatchesSDL2(srcrect->h, dstrect->h)) {
+        return SDL_FALSE;
+    }
+
+    table = GetStretchColumns(srcrect->w, dstrect->w);
+    if (!table) {
+        return SDL_FALSE;
+    }
+
+    stretch.src = src;
+    stretch.srcrect = *srcrect;
+    stretch.dst = dst;
+    stretch.dstrect = *dstrect;
+    stretch.columns = table->columns;
+
+    if (((dstrect->w * dstrect->h) >= BAND_MIN_PIXELS) && GrabBandWorkers()) {
+        const int bands = SDL_min(NumBandWorkers + 1, dstrect->h);
+        int i;
+        for (i = 0; i < bands; i++) {
+            BandJob *job = &BandJobs[i];
+            const int y1 = (dstrect->h * i) / bands;
+            const int y2 = (dstrect->h * (i + 1)) / bands;
+            job->type = BANDJOB_STRETCH;
+            job->dst = dst;
+            job->stretch = &stretch;
+            job->dstrect.x = 0;
+            job->dstrect.y = y1;
+            job->dstrect.w = dstrect->w;
+            job->dstrect.h = y2 - y1;
+        }
+        RunBandJobs(bands);
+        ReleaseBandWorkers();
+    } else {
+        StretchRows(&stretch, 0, dstrect->h);
+    }
+
+    ReleaseStretchColumns(table);
+    return SDL_TRUE;
+}
+
 DECLSPEC12 int SDLCALL
 SDL_SoftStretch(SDL12_Surface *src12, SDL12_Rect *srcrect12, SDL12_Surface *dst12, SDL12_Rect *dstrect12)
 {
     SDL_Rect srcrect20, dstrect20;
+
+    SurfaceWillBeRead12(src12);
+    SurfaceWillChange12(dst12);
+
+    if (srcrect12) {
+        Rect12to20(srcrect12, &srcrect20);
+    } else {
+        srcrect20.x = srcrect20.y = 0;
+        srcrect20.w = src12->surface20->w;
+        srcrect20.h = src12->surface20->h;
+    }
+
+    if (dstrect12) {
+        Rect12to20(dstrect12, &dstrect20);
+    } else {
+        dstrect20.x = dstrect20.y = 0;
+        dstrect20.w = dst12->surface20->w;
+        dstrect20.h = dst12->surface20->h;
+    }
+
+    if (ExactSoftStretch(src12->surface20, &srcrect20, dst12->surface20, &dstrect20)) {
+        return 0;
+    }
+
     return SDL20_SoftStretch(src12->surface20,
-                             srcrect12 ? Rect12to20(srcrect12, &srcrect20) : NULL,
+                             srcrect12 ? &srcrect20 : NULL,
                              dst12->surface20,
-                             dstrect12 ? Rect12to20(dstrect12, &dstrect20) : NULL);
+                             dstrect12 ? &dstrect20 : NULL);
 }
 
 DECLSPEC12 int SDLCALL
@@ -7114,6 +9848,8 @@ SDL_SetAlpha(SDL12_Surface *surface12, Uint32 flags12, Uint8 value)
     const SDL_bool addkey = (flags12 & SDL12_SRCALPHA) ? SDL_TRUE : SDL_FALSE;
     int retval = 0;
 
+    SurfaceWillChange12(surface12);
+
     if (addkey) {
         if (!surface12->format->Amask) {  /* whole-surface alpha is ignored if surface has an alpha channel. */
             retval = SDL20_SetSurfaceAlphaMod(surface12->surface20, value);
@@ -7141,6 +9877,7 @@ DECLSPEC12 int SDLCALL
 SDL_LockSurface(SDL12_Surface *surface12)
 {
     int retval = 0;
+    SurfaceWillChange12(surface12);  /* we have to assume the app will write to it. */
     /* just pretend to lock for the screen surface, but ignore it. */
     if (surface12 != VideoSurface12) {
         retval = SDL20_LockSurface(surface12->surface20);
@@ -7165,7 +9902,10 @@ DECLSPEC12 int SDLCALL
 SDL_SetColorKey(SDL12_Surface *surface12, Uint32 flag12, Uint32 key)
 {
     const SDL_bool addkey = (flag12 & SDL12_SRCCOLORKEY) ? SDL_TRUE : SDL_FALSE;
-    const int retval = SDL20_SetColorKey(surface12->surface20, addkey, key);
+    int retval;
+
+    SurfaceWillChange12(surface12);
+    retval = SDL20_SetColorKey(surface12->surface20, addkey, key);
     if (SDL20_GetColorKey(surface12->surface20, &surface12->format->colorkey) < 0) {
         surface12->format->colorkey = 0;
     }
@@ -7195,6 +9935,7 @@ SDL_ConvertSurface(SDL12_Surface *src12, const SDL12_PixelFormat *format12, Uint
     if (flags12 & SDL12_PREALLOC) flags20 |= SDL_PREALLOC;
     if (flags12 & SDL12_RLEACCEL) flags20 |= SDL_RLEACCEL;
 
+    SurfaceWillBeRead12(src12);
     surface20 = SDL20_ConvertSurface(src12->surface20, PixelFormat12to20(&format20, &palette20, format12), flags20);
     if (surface20) {
         retval = Surface20to12(surface20);
@@ -7219,12 +9960,16 @@ DECLSPEC12 SDL12_Surface * SDLCALL
 SDL_DisplayFormat(SDL12_Surface *surface12)
 {
     const Uint32 flags = surface12->flags & (SDL12_SRCCOLORKEY|SDL12_SRCALPHA|SDL12_RLEACCELOK);
+    SDL12_Surface *retval;
+
     if (!VideoSurface12 || !VideoSurface12->surface20) {
         SDL20_SetError("No video mode has been set");
         return NULL;
     }
 
-    return SDL_ConvertSurface(surface12, VideoSurface12->format, flags);
+    retval = SDL_ConvertSurface(surface12, VideoSurface12->format, flags);
+    MarkHardwareSurface(retval);
+    return retval;
 }
 
 DECLSPEC12 SDL12_Surface * SDLCALL
@@ -7248,6 +9993,7 @@ SDL_DisplayFormatAlpha(SDL12_Surface *surface12)
 
     retval = SDL_ConvertSurface(surface12, PixelFormat20to12(&fmt12, NULL, fmt20), flags);
     SDL20_FreeFormat(fmt20);
+    MarkHardwareSurface(retval);
     return retval;
 }
 
@@ -7272,27 +10018,37 @@ PresentScreen(void)
         SDL_PumpEvents();
     }
 
-    SDL20_RenderClear(renderer);
-    SDL20_RenderCopy(renderer, VideoTexture20, NULL, NULL);
-
-    /* Render any pending YUV overlay over the surface texture. */
-    overlay = QueuedDisplayOverlays.next;
-    if (overlay) {
-        while (overlay != NULL) {
-            QueuedOverlayItem *next = overlay->next;
-            if (overlay->overlay12) {
-                SDL12_YUVData *hwdata = (SDL12_YUVData *) overlay->overlay12->hwdata;
-                SDL_Rect dstrect20;
-                SDL20_RenderCopy(renderer, hwdata->texture20, NULL, Rect12to20(&overlay->dstrect12, &dstrect20));
+    if (VideoWindowSurfacePresent) {
+        /* SDL_UpdateRects already put the pixels in the window surface, and there are no overlays or hardware blits in this mode. */
+        FlushWindowSurfaceDirtyRects();
+    } else {
+        SDL20_RenderClear(renderer);
+        if (!DisplayListHidesScreen) {
+            SDL20_RenderCopy(renderer, VideoTexture20, NULL, NULL);
+        }
+        RenderDisplayList(renderer);  /* hardware surface blits, if any. */
+
+        /* Render any pending YUV overlay over the surface texture. */
+        overlay = QueuedDisplayOverlays.next;
+        if (overlay) {
+            while (overlay != NULL) {
+                QueuedOverlayItem *next = overlay->next;
+                if (overlay->overlay12) {
+                    SDL12_YUVData *hwdata = (SDL12_YUVData *) overlay->overlay12->hwdata;
+                    SDL_Rect dstrect20;
+                    SDL20_RenderCopy(renderer, hwdata->textures20[overlay->texture], NULL, Rect12to20(&overlay->dstrect12, &dstrect20));
+                    hwdata->queued[overlay->texture]--;
+                }
+                overlay->next = QueuedOverlayItemPool;
+                QueuedOverlayItemPool = overlay;
+                overlay = next;
             }
-            SDL_free(overlay);
-            overlay = next;
+            QueuedDisplayOverlays.next = NULL;
+            QueuedDisplayOverlaysTail = &QueuedDisplayOverlays;
         }
-        QueuedDisplayOverlays.next = NULL;
-        QueuedDisplayOverlaysTail = &QueuedDisplayOverlays;
-    }
 
-    SDL20_RenderPresent(renderer);
+        SDL20_RenderPresent(renderer);
+    }
     VideoSurfaceUpdatedInBackgroundThread = SDL_FALSE;
     VideoSurfaceLastPresentTicks = SDL20_GetTicks();
     VideoSurfacePresentTicks = 0;
@@ -7483,6 +10239,8 @@ SDL_UpdateRects(SDL12_Surface *surface12, int numrects, SDL12_Rect *rects12)
         const int srcpitch = surface12->pitch;
         SDL_bool whole_screen = SDL_FALSE;
         SDL_Renderer *renderer = NULL;
+        SDL_Surface *winsurface = NULL;
+        SDL12_Rect fullrect12;
         void *pixels = NULL;
         SDL_Rect rect20;
         int pitch = 0;
@@ -7492,6 +10250,20 @@ SDL_UpdateRects(SDL12_Surface *surface12, int numrects, SDL12_Rect *rects12)
             renderer = LockVideoRenderer();  /* must own the renderer before locking the texture! */
         }
 
+        if (renderer && VideoWindowSurfacePresent) {
+            winsurface = SDL20_GetWindowSurface(VideoWindow20);
+            /* lost the window surface, or the user resized the window? It needs scaling now, so go back to the renderer, and give it the whole screen. */
+            if (!winsurface || (winsurface->w != VideoSurface12->w) || (winsurface->h != VideoSurface12->h)) {
+                winsurface = NULL;
+                VideoWindowSurfacePresent = SDL_FALSE;
+                VideoWindowSurfaceDirtyCount = 0;
+                VideoWindowSurfaceDirtyAll = SDL_FALSE;
+                SDL20_memset(&fullrect12, '\0', sizeof (fullrect12));
+                rects12 = &fullrect12;
+                numrects = 1;
+            }
+        }
+
         for (i = 0; i < numrects; i++) {
             UpdateRect12to20(surface12, &rects12[i], &rect20, &whole_screen);
 
@@ -7501,6 +10273,21 @@ SDL_UpdateRects(SDL12_Surface *surface12, int numrects, SDL12_Rect *rects12)
             if (!rect20.w || !rect20.h) {
                 continue;
             }
+
+            if (winsurface) {
+                SDL_Rect dstrect20;
+                SDL20_memcpy(&dstrect20, &rect20, sizeof (SDL_Rect));
+                surface12->surface20->format->palette = VideoPhysicalPalette20;
+                SDL20_UpperBlit(VideoSurface12->surface20, &rect20, winsurface, &dstrect20);
+                surface12->surface20->format->palette = logicalPal;
+                if (whole_screen) {
+                    VideoWindowSurfaceDirtyAll = SDL_TRUE;
+                } else {
+                    AddWindowSurfaceDirtyRect(&rect20);
+                }
+                continue;
+            }
+
             if (SDL20_LockTexture(VideoTexture20, &rect20, &pixels, &pitch) < 0) {
                 continue;  /* oh well */
             }
@@ -7773,8 +10560,14 @@ SDL_WM_ToggleFullScreen(SDL12_Surface *surface)
         if (retval) {
             SDL_Renderer *renderer = LockVideoRenderer();
             if (renderer) {
+                /* the window surface is a different size now, so it might have to go back to being scaled by the renderer (or vice versa). */
+                SDL_bool push_whole_screen;
                 SDL20_RenderSetLogicalSize(renderer, VideoSurface12->w, VideoSurface12->h);
+                push_whole_screen = (RecheckWindowSurfacePresent() || VideoWindowSurfacePresent) ? SDL_TRUE : SDL_FALSE;
                 UnlockVideoRenderer();
+                if (push_whole_screen) {
+                    SDL_UpdateRect(VideoSurface12, 0, 0, 0, 0);
+                }
             }
         }
     }
@@ -8075,17 +10868,19 @@ SDL_CreateYUVOverlay(int w, int h, Uint32 format12, SDL12_Surface *display12)
     /* SDL 1.2 has you pass the screen surface in here, but it doesn't check that it's _actually_ the screen surface,
        which implies you should be able to blit YUV overlays to other surfaces too...but then SDL_DisplayYUVOverlay
        always uses the screen surface unconditionally. As such, and because overlays were sort of hostile to software
-       rendering anyhow, we always make an SDL_Texture in here and draw over the screen pixels, in hopes that the GPU
-       gives us a boost here. */
+       rendering anyhow, for the screen we make an SDL_Texture in here and draw over the screen pixels, in hopes that
+       the GPU gives us a boost here. Media apps do make overlays for offscreen surfaces (thumbnails, transitions),
+       though, so for anything else we convert to RGB in software and blit into that surface on display. */
 
     const char *old_scale_quality = SDL20_GetHint(SDL_HINT_RENDER_SCALE_QUALITY);
     SDL12_Overlay *retval = NULL;
     SDL12_YUVData *hwdata = NULL;
     SDL_Renderer *renderer = NULL;
     Uint32 format20 = 0;
+    int i;
 
-    if (display12 != VideoSurface12) {  /* SDL 1.2 doesn't check this, but it seems irresponsible not to. */
-        SDL20_SetError("YUV overlays are only supported on the screen surface");
+    if (!display12 || !display12->surface20) {
+        SDL20_InvalidParamError("display");
         return NULL;
     }
 
@@ -8112,7 +10907,15 @@ SDL_CreateYUVOverlay(int w, int h, Uint32 format12, SDL12_Surface *display12)
     }
 
     hwdata = (SDL12_YUVData *) (retval + 1);
-    hwdata->pixelbuf = (Uint8 *) SDL20_calloc(1, (w * 2) * h);
+    if ((format12 == SDL12_YV12_OVERLAY) || (format12 == SDL12_IYUV_OVERLAY)) {
+        /* 12 bits per pixel: a full size Y plane, and quarter size U and V
+           planes. The pitch is w/2 like 1.2, but SDL2 reads (w+1)/2 pixels
+           of (h+1)/2 rows for odd sizes, so leave room for that. */
+        const int chromasize = ((w + 1) / 2) * ((h + 1) / 2);
+        hwdata->pixelbuf = (Uint8 *) SDL20_calloc(1, (w * h) + (chromasize * 2));
+    } else {
+        hwdata->pixelbuf = (Uint8 *) SDL20_calloc(1, (w * 2) * h);
+    }
     if (!hwdata->pixelbuf) {
         SDL20_free(retval);
         SDL20_OutOfMemory();
@@ -8125,41 +10928,140 @@ SDL_CreateYUVOverlay(int w, int h, Uint32 format12, SDL12_Surface *display12)
         hwdata->pitches[0] = w;
         hwdata->pitches[1] = hwdata->pitches[2] = w / 2;
         hwdata->pixels[1] = hwdata->pixels[0] + (w * h);
-        hwdata->pixels[2] = hwdata->pixels[1] + ((w / 2) * h);
+        hwdata->pixels[2] = hwdata->pixels[1] + (((w + 1) / 2) * ((h + 1) / 2));
     } else {
         retval->planes = 1;
         hwdata->pitches[0] = w * 2;
     }
+    SDL20_memcpy(hwdata->bufpixels, hwdata->pixels, sizeof (hwdata->pixels));
+    SDL20_memcpy(hwdata->bufpitches, hwdata->pitches, sizeof (hwdata->pitches));
+    hwdata->locked = -1;
+    hwdata->format20 = format20;
+
+    retval->format = format12;
+    retval->w = w;
+    retval->h = h;
+    retval->hwfuncs = (void *) 0x1;  /* in case it's important for this to be non-NULL. */
+    retval->hwdata = hwdata;
+    retval->pitches = hwdata->pitches;
+
+    /* Some programs (e.g. mplayer) access pixels without locking. */
+    retval->pixels = hwdata->pixels;
+    hwdata->dirty = SDL_TRUE;
+
+    if (display12 != VideoSurface12) {
+        hwdata->target = display12;
+        display12->refcount++;  /* don't let it go away before we do. */
+        retval->hw_overlay = 0;
+        return retval;
+    }
 
     renderer = LockVideoRenderer();
 
     SDL20_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
-    hwdata->texture20 = SDL20_CreateTexture(renderer, format20, SDL_TEXTUREACCESS_STREAMING, w, h);
+    for (i = 0; i < SDL12_YUV_TEXTURES; i++) {
+        hwdata->textures20[i] = SDL20_CreateTexture(renderer, format20, SDL_TEXTUREACCESS_STREAMING, w, h);
+        if (!hwdata->textures20[i]) {
+            break;
+        }
+    }
     SDL20_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, old_scale_quality);
 
-    UnlockVideoRenderer();
-
-    if (!hwdata->texture20) {
+    if (!hwdata->textures20[0]) {
+        UnlockVideoRenderer();
         SDL20_free(hwdata->pixelbuf);
         SDL20_free(retval);
         return NULL;
+    } else if (i < SDL12_YUV_TEXTURES) {  /* couldn't make them all? Make do with one. */
+        while (--i > 0) {
+            SDL20_DestroyTexture(hwdata->textures20[i]);
+            hwdata->textures20[i] = NULL;
+        }
+        SDL20_ClearError();
     }
 
-    retval->format = format12;
-    retval->w = w;
-    retval->h = h;
-    retval->hwfuncs = (void *) 0x1;  /* in case it's important for this to be non-NULL. */
-    retval->hwdata = hwdata;
-    retval->hw_overlay = 1;
-    retval->pitches = hwdata->pitches;
+    UnlockVideoRenderer();
 
-    /* Some programs (e.g. mplayer) access pixels without locking. */
-    retval->pixels = hwdata->pixels;
-    hwdata->dirty = SDL_TRUE;
+    LiveYUVOverlays++;
+    if (VideoWindowSurfacePresent) {
+        /* overlays need the renderer; switch back to it, with everything in the texture. */
+        VideoWindowSurfacePresent = SDL_FALSE;
+        SDL_UpdateRect(VideoSurface12, 0, 0, 0, 0);
+    }
+
+    retval->hw_overlay = 1;
 
     return retval;
 }
 
+/* SDL12COMPAT_ZERO_COPY_OVERLAYS support: instead of having the app write
+   into pixelbuf and copying that into a texture on display, lock a texture
+   and let the app write into its memory directly. This only works if the
+   app writes between SDL_LockYUVOverlay and SDL_UnlockYUVOverlay or
+   SDL_DisplayYUVOverlay, which SMPEG and mplayer don't, so it's opt-in.
+   It also only works if the app writes the whole frame every time: memory
+   from SDL_LockTexture is write-only with undefined contents, and we cycle
+   through several textures besides, so a decoder that only rewrites the
+   blocks that changed would show leftovers from some older frame. We don't
+   copy the last frame in to cover for that; that copy is exactly what this
+   option exists to avoid. */
+static void
+LockOverlayTexture(SDL12_Overlay *overlay12, SDL12_YUVData *hwdata)
+{
+    void *pixels = NULL;
+    int pitch = 0;
+    int idx = -1;
+    int i;
+
+    if (LockVideoRenderer() == NULL) {
+        UnlockVideoRenderer();
+        return;
+    }
+
+    for (i = 1; i <= SDL12_YUV_TEXTURES; i++) {  /* don't write into a frame that's still queued for display. */
+        const int tryidx = (hwdata->current + i) % SDL12_YUV_TEXTURES;
+        if (hwdata->textures20[tryidx] && !hwdata->queued[tryidx]) {
+            idx = tryidx;
+            break;
+        }
+    }
+
+    if ((idx >= 0) && (SDL20_LockTexture(hwdata->textures20[idx], NULL, &pixels, &pitch) == 0)) {
+        if (pitch > 0xFFFF) {  /* 1.2's pitches are Uint16. Unlikely, but... */
+            SDL20_UnlockTexture(hwdata->textures20[idx]);
+        } else {
+            hwdata->locked = idx;
+            hwdata->pixels[0] = (Uint8 *) pixels;
+            hwdata->pitches[0] = (Uint16) pitch;
+            if (overlay12->planes == 3) {
+                /* SDL2 lays out planar textures like this, U then V for IYUV and V then U for YV12, same as 1.2's planes. */
+                const int chromapitch = (pitch + 1) / 2;
+                hwdata->pixels[1] = hwdata->pixels[0] + (pitch * overlay12->h);
+                hwdata->pixels[2] = hwdata->pixels[1] + (chromapitch * ((overlay12->h + 1) / 2));
+                hwdata->pitches[1] = hwdata->pitches[2] = (Uint16) chromapitch;
+            }
+        }
+    }
+
+    UnlockVideoRenderer();
+}
+
+/* The app is done writing to the locked texture; upload it and go back to pixelbuf. */
+static void
+UnlockOverlayTexture(SDL12_YUVData *hwdata)
+{
+    if (hwdata->locked >= 0) {
+        LockVideoRenderer();
+        SDL20_UnlockTexture(hwdata->textures20[hwdata->locked]);
+        UnlockVideoRenderer();
+        hwdata->current = hwdata->locked;
+        hwdata->locked = -1;
+        hwdata->dirty = SDL_FALSE;  /* the texture has the frame now. */
+        SDL20_memcpy(hwdata->pixels, hwdata->bufpixels, sizeof (hwdata->pixels));
+        SDL20_memcpy(hwdata->pitches, hwdata->bufpitches, sizeof (hwdata->pitches));
+    }
+}
+
 DECLSPEC12 int SDLCALL
 SDL_LockYUVOverlay(SDL12_Overlay *overlay12)
 {
@@ -8176,11 +11078,96 @@ SDL_LockYUVOverlay(SDL12_Overlay *overlay12)
        if the overlay has been locked since last time (and even
        if it is still locked), to accomodate this usage pattern. */
 
-    hwdata = (SDL12_YUVData *) overlay12->hwdata;
-    hwdata->dirty = SDL_TRUE;  /* assume the contents will change and we must upload */
-    overlay12->pixels = hwdata->pixels;
+    hwdata = (SDL12_YUVData *) overlay12->hwdata;
+    if (WantZeroCopyOverlays && (hwdata->locked < 0)) {
+        LockOverlayTexture(overlay12, hwdata);  /* if this fails, we just use pixelbuf like normal. */
+    }
+    if (hwdata->locked < 0) {
+        hwdata->dirty = SDL_TRUE;  /* assume the contents will change and we must upload */
+    }
+    overlay12->pixels = hwdata->pixels;
+
+    return 0;  /* success */
+}
+
+/* Software overlays: convert the frame to RGB with SDL2 (which has SIMD
+   converters for all of these formats, and uses BT.601 like 1.2 did) and
+   scale-blit it into the target surface. */
+static int
+SoftwareDisplayYUVOverlay(SDL12_Overlay *overlay12, SDL12_YUVData *hwdata, const SDL12_Rect *dstrect12)
+{
+    const int w = overlay12->w;
+    const int h = overlay12->h;
+    SDL_Rect dstrect20;
+    int retval;
+
+    if (!hwdata->rgb20) {
+        hwdata->rgb20 = SDL20_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_XRGB8888);
+        if (!hwdata->rgb20) {
+            return -1;
+        }
+        hwdata->dirty = SDL_TRUE;
+    }
+
+    if (hwdata->dirty) {
+        const Uint8 *src = hwdata->pixels[0];
+        int srcpitch = hwdata->pitches[0];
+
+        if (overlay12->planes == 3) {
+            /* SDL_ConvertPixels wants the planes back to back, with (pitch+1)/2 chroma pitch. */
+            const int ysize = w * h;
+            const int chromapitch = (w + 1) / 2;
+            const int chromarows = (h + 1) / 2;
+            if ((hwdata->pitches[0] != w) || (hwdata->pitches[1] != chromapitch) || (hwdata->pitches[2] != chromapitch) ||
+                (hwdata->pixels[1] != (hwdata->pixels[0] + ysize)) ||
+                (hwdata->pixels[2] != (hwdata->pixels[1] + (chromapitch * chromarows)))) {
+                Uint8 *dst;
+                int plane, y;
+                if (!hwdata->packedbuf) {
+                    hwdata->packedbuf = (Uint8 *) SDL20_malloc(ysize + (chromapitch * chromarows * 2));
+                    if (!hwdata->packedbuf) {
+                        return SDL20_OutOfMemory();
+                    }
+                }
+                /* 1.2's w/2 x h/2 chroma planes are a pixel short for odd
+                   sizes, so the last column and row get repeated. */
+                dst = hwdata->packedbuf;
+                for (plane = 0; plane < 3; plane++) {
+                    const int dstpitch = plane ? chromapitch : w;
+                    const int rows = plane ? chromarows : h;
+                    const int srcrows = plane ? SDL_max(h / 2, 1) : h;
+                    const int rowlen = plane ? SDL_max(SDL_min(chromapitch, (int) hwdata->pitches[plane]), 1) : w;
+                    for (y = 0; y < rows; y++) {
+                        SDL20_memcpy(dst, hwdata->pixels[plane] + (SDL_min(y, srcrows - 1) * hwdata->pitches[plane]), rowlen);
+                        if (rowlen < dstpitch) {
+                            dst[dstpitch - 1] = dst[rowlen - 1];
+                        }
+                        dst += dstpitch;
+                    }
+                }
+                src = hwdata->packedbuf;
+                srcpitch = w;
+            }
+        }
+
+        if (SDL20_ConvertPixels(w, h, hwdata->format20, src, srcpitch, SDL_PIXELFORMAT_XRGB8888, hwdata->rgb20->pixels, hwdata->rgb20->pitch) < 0) {
+            return -1;
+        }
+
+        if (overlay12->pixels == NULL) {  /* must leave it marked as dirty if still locked! */
+            hwdata->dirty = SDL_FALSE;
+        }
+    }
 
-    return 0;  /* success */
+    SurfaceWillChange12(hwdata->target);
+
+    Rect12to20(dstrect12, &dstrect20);
+    if ((dstrect20.w == w) && (dstrect20.h == h)) {
+        retval = SDL20_UpperBlit(hwdata->rgb20, NULL, hwdata->target->surface20, &dstrect20);
+    } else {
+        retval = SDL20_UpperBlitScaled(hwdata->rgb20, NULL, hwdata->target->surface20, &dstrect20);
+    }
+    return retval;
 }
 
 DECLSPEC12 int SDLCALL
@@ -8197,6 +11184,12 @@ SDL_DisplayYUVOverlay(SDL12_Overlay *overlay12, SDL12_Rect *dstrect12)
     if (!dstrect12) {
         return SDL20_InvalidParamError("dstrect");
     }
+
+    hwdata = (SDL12_YUVData *) overlay12->hwdata;
+    if (hwdata->target) {
+        return SoftwareDisplayYUVOverlay(overlay12, hwdata, dstrect12);
+    }
+
     if ((renderer = LockVideoRenderer()) == NULL) {
         return SDL20_SetError("No software screen surface available");
     }
@@ -8216,32 +11209,55 @@ SDL_DisplayYUVOverlay(SDL12_Overlay *overlay12, SDL12_Rect *dstrect12)
         }
     }
 
-    if ((overlay = (QueuedOverlayItem *) SDL_malloc(sizeof (QueuedOverlayItem))) == NULL) {
+    if (QueuedOverlayItemPool) {
+        overlay = QueuedOverlayItemPool;
+        QueuedOverlayItemPool = overlay->next;
+    } else if ((overlay = (QueuedOverlayItem *) SDL20_malloc(sizeof (QueuedOverlayItem))) == NULL) {
         UnlockVideoRenderer();
         return SDL20_OutOfMemory();
     }
 
     hwdata = (SDL12_YUVData *) overlay12->hwdata;
 
+    if (hwdata->locked >= 0) {
+        UnlockOverlayTexture(hwdata);  /* app wrote straight into a texture; that's the upload. */
+    }
+
     /* Upload contents if we've been locked, even if we're _still_ locked, to
        work around an SMPEG quirk. */
     if (hwdata->dirty) {
+        SDL_Texture *texture20;
         SDL_Rect rect20;
+        int i;
+
+        /* Use the next texture that isn't waiting to be drawn, so a frame
+           that's already queued isn't changed under it. If they're all
+           queued (an app displaying from a background thread can get ahead
+           of presentation), reuse the current one, like we always used to. */
+        for (i = 1; i <= SDL12_YUV_TEXTURES; i++) {
+            const int idx = (hwdata->current + i) % SDL12_YUV_TEXTURES;
+            if (hwdata->textures20[idx] && !hwdata->queued[idx]) {
+                hwdata->current = idx;
+                break;
+            }
+        }
+        texture20 = hwdata->textures20[hwdata->current];
+
         rect20.x = rect20.y = 0;
         rect20.w = overlay12->w;
         rect20.h = overlay12->h;
         if (overlay12->format == SDL12_IYUV_OVERLAY) {
-            SDL20_UpdateYUVTexture(hwdata->texture20, &rect20,
+            SDL20_UpdateYUVTexture(texture20, &rect20,
                                  hwdata->pixels[0], hwdata->pitches[0],
                                  hwdata->pixels[1], hwdata->pitches[1],
                                  hwdata->pixels[2], hwdata->pitches[2]);
         } else if (overlay12->format == SDL12_YV12_OVERLAY) {
-            SDL20_UpdateYUVTexture(hwdata->texture20, &rect20,
+            SDL20_UpdateYUVTexture(texture20, &rect20,
                                  hwdata->pixels[0], hwdata->pitches[0],
                                  hwdata->pixels[2], hwdata->pitches[2],
                                  hwdata->pixels[1], hwdata->pitches[1]);
         } else {
-            SDL20_UpdateTexture(hwdata->texture20, &rect20, hwdata->pixels[0], hwdata->pitches[0]);
+            SDL20_UpdateTexture(texture20, &rect20, hwdata->pixels[0], hwdata->pitches[0]);
         }
 
         if (overlay12->pixels == NULL) {  /* must leave it marked as dirty if still locked! */
@@ -8253,6 +11269,8 @@ SDL_DisplayYUVOverlay(SDL12_Overlay *overlay12, SDL12_Rect *dstrect12)
        and start a timer going to force a present, in case they don't. */
 
     overlay->overlay12 = overlay12;
+    overlay->texture = hwdata->current;
+    hwdata->queued[hwdata->current]++;
     SDL20_memcpy(&overlay->dstrect12, dstrect12, sizeof (SDL12_Rect));
     overlay->next = NULL;
 
@@ -8277,7 +11295,9 @@ SDL_UnlockYUVOverlay(SDL12_Overlay *overlay12)
     /*if (overlay12) {
         overlay12->pixels = NULL;
     }*/
-    (void)overlay12;
+    if (overlay12) {
+        UnlockOverlayTexture((SDL12_YUVData *) overlay12->hwdata);
+    }
 }
 
 DECLSPEC12 void SDLCALL
@@ -8295,51 +11315,253 @@ SDL_FreeYUVOverlay(SDL12_Overlay *overlay12)
         }
 
         if (renderer) {
-            SDL20_DestroyTexture(hwdata->texture20);
-            UnlockVideoRenderer();
+            int i;
+            for (i = 0; i < SDL12_YUV_TEXTURES; i++) {
+                if (hwdata->textures20[i]) {
+                    SDL20_DestroyTexture(hwdata->textures20[i]);
+                }
+            }
         }
+        UnlockVideoRenderer();
 
         SDL20_free(hwdata->pixelbuf);
+        if (hwdata->target) {
+            SDL20_FreeSurface(hwdata->rgb20);
+            SDL20_free(hwdata->packedbuf);
+            SDL_FreeSurface(hwdata->target);  /* drop our reference. */
+        } else {
+            LiveYUVOverlays--;
+        }
         SDL20_free(overlay12);
     }
 }
 
-DECLSPEC12 void * SDLCALL
-SDL_GL_GetProcAddress(const char *sym)
+DECLSPEC12 int SDLCALL SDL12COMPAT_GetAudioLatency(double *device_ms, double *buffered_avg_ms, double *buffered_max_ms);
+
+/* Shimmed entry points that SDL_GL_GetProcAddress hands out instead of the
+   real thing. Lengths are precomputed so a lookup can skip most entries
+   without touching the string. */
+typedef struct GLProcShim
 {
+    const char *name;
+    size_t len;
+    void *proc;
+    SDL_bool msaa_tracking;
+} GLProcShim;
+
+#define GLPROCSHIM(name, fn) { name, sizeof (name) - 1, (void *) fn, SDL_FALSE }
+#define GLPROCSHIM_TRACKING(name, fn) { name, sizeof (name) - 1, (void *) fn, SDL_TRUE }
+static const GLProcShim GLProcShims[] = {
     /* see comments on glBindFramebuffer_shim_for_scaling for explanation */
-    if ((SDL20_strcmp(sym, "glBindFramebuffer") == 0) || (SDL20_strcmp(sym, "glBindFramebufferEXT") == 0)) {
-        return (void *) glBindFramebuffer_shim_for_scaling;
+    GLPROCSHIM("glBindFramebuffer", glBindFramebuffer_shim_for_scaling),
+    GLPROCSHIM("glBindFramebufferEXT", glBindFramebuffer_shim_for_scaling),
+    /* these functions all need to have an MSAA resolve inserted before use */
+    GLPROCSHIM("glReadPixels", glReadPixels_shim_for_scaling),
+    GLPROCSHIM("glCopyPixels", glCopyPixels_shim_for_scaling),
+    GLPROCSHIM("glCopyTexImage1D", glCopyTexImage1D_shim_for_scaling),
+    GLPROCSHIM("glCopyTexSubImage1D", glCopyTexSubImage1D_shim_for_scaling),
+    GLPROCSHIM("glCopyTexImage2D", glCopyTexImage2D_shim_for_scaling),
+    GLPROCSHIM("glCopyTexSubImage2D", glCopyTexSubImage2D_shim_for_scaling),
+    GLPROCSHIM("glCopyTexSubImage3D", glCopyTexSubImage3D_shim_for_scaling),
+    /* these functions are specific to the shim library */
+    GLPROCSHIM("SDL12COMPAT_GetWindow", SDL12COMPAT_GetWindow),
+    GLPROCSHIM("SDL12COMPAT_GetStartupPhase", SDL12COMPAT_GetStartupPhase),
+    GLPROCSHIM("SDL12COMPAT_GetAudioLatency", SDL12COMPAT_GetAudioLatency),
+    /* these mark the multisample FBO as needing a resolve (SDL12COMPAT_MSAA_RESOLVE_TRACKING only) */
+    GLPROCSHIM_TRACKING("glClear", glClear_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glEnd", glEnd_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glDrawArrays", glDrawArrays_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glDrawElements", glDrawElements_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glCallList", glCallList_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glCallLists", glCallLists_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glDrawPixels", glDrawPixels_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glBitmap", glBitmap_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRectd", glRectd_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRectdv", glRectdv_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRectf", glRectf_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRectfv", glRectfv_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRecti", glRecti_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRectiv", glRectiv_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRects", glRects_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glRectsv", glRectsv_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glDrawRangeElements", glDrawRangeElements_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glMultiDrawArrays", glMultiDrawArrays_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glMultiDrawElements", glMultiDrawElements_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glDrawArraysInstanced", glDrawArraysInstanced_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glDrawElementsInstanced", glDrawElementsInstanced_shim_for_scaling),
+    GLPROCSHIM_TRACKING("glBlitFramebuffer", glBlitFramebuffer_shim_for_scaling)
+};
+#undef GLPROCSHIM
+#undef GLPROCSHIM_TRACKING
+
+static void *
+FindGLProcShim(const char *sym, size_t len)
+{
+    /* the tracking shims are only worth it if there's a multisample FBO to track. This is
+       decided per context, which is fine, since the lookup cache is per context, too. */
+    const SDL_bool tracking = (WantMSAAResolveTracking && OpenGLLogicalScalingMultisampleFBO) ? SDL_TRUE : SDL_FALSE;
+    int i;
+    for (i = 0; i < (int) SDL_arraysize(GLProcShims); i++) {
+        const GLProcShim *shim = &GLProcShims[i];
+        if ((shim->len == len) && (SDL20_memcmp(shim->name, sym, len) == 0)) {
+            if (!shim->msaa_tracking) {
+                return shim->proc;
+            }
+            /* some of these are newer than GL 1.1; only wrap them if the real thing is there. */
+            return (tracking && SDL20_GL_GetProcAddress(sym)) ? shim->proc : NULL;
+        }
     }
+    return NULL;
+}
 
-    /* these functions all need to have an MSAA resolve inserted before use */
-    if ((SDL20_strcmp(sym, "glReadPixels") == 0)) {
-        return (void *) glReadPixels_shim_for_scaling;
+/* Extension loaders (GLEW and friends) ask for thousands of names at startup,
+   and some apps look things up every frame, so we remember what we've already
+   resolved. The addresses are only good for the current GL context, so this
+   gets thrown out when the context goes away. Failed lookups aren't cached,
+   since a library might get loaded later. */
+typedef struct GLProcCacheEntry
+{
+    Uint32 hash;
+    char *name;  /* NULL if slot is unused. */
+    void *proc;
+} GLProcCacheEntry;
+
+static GLProcCacheEntry *GLProcCache = NULL;
+static int GLProcCacheSize = 0;  /* always a power of two. */
+static int GLProcCacheUsed = 0;
+static SDL_GLContext GLProcCacheContext = NULL;
+static SDL_SpinLock GLProcCacheLock = 0;
+
+static Uint32
+HashGLProcName(const char *sym, size_t *_len)
+{
+    Uint32 hash = 2166136261u;  /* FNV-1a */
+    const Uint8 *ptr = (const Uint8 *) sym;
+    size_t len = 0;
+
+    while (ptr[len]) {
+        hash = (hash ^ ptr[len]) * 16777619u;
+        len++;
+    }
+
+    *_len = len;
+    return hash;
+}
+
+/* call with GLProcCacheLock held. */
+static void
+ClearGLProcCacheLocked(void)
+{
+    int i;
+    for (i = 0; i < GLProcCacheSize; i++) {
+        SDL20_free(GLProcCache[i].name);
+    }
+    SDL20_free(GLProcCache);
+    GLProcCache = NULL;
+    GLProcCacheSize = GLProcCacheUsed = 0;
+    GLProcCacheContext = NULL;
+}
+
+static void
+ClearGLProcCache(void)
+{
+    SDL20_AtomicLock(&GLProcCacheLock);
+    ClearGLProcCacheLocked();
+    SDL20_AtomicUnlock(&GLProcCacheLock);
+}
+
+/* call with GLProcCacheLock held. Returns the slot holding `sym`, or the empty slot it would go in. */
+static GLProcCacheEntry *
+FindGLProcCacheSlot(GLProcCacheEntry *cache, const int size, const Uint32 hash, const char *sym)
+{
+    const int mask = size - 1;
+    int i = (int) (hash & mask);
+    while (cache[i].name) {
+        if ((cache[i].hash == hash) && (SDL20_strcmp(cache[i].name, sym) == 0)) {
+            break;
+        }
+        i = (i + 1) & mask;
     }
-    if ((SDL20_strcmp(sym, "glCopyPixels") == 0)) {
-        return (void *) glCopyPixels_shim_for_scaling;
+    return &cache[i];
+}
+
+/* call with GLProcCacheLock held. Failure to cache isn't fatal, we just look it up again next time. */
+static void
+AddGLProcCacheEntryLocked(const Uint32 hash, const char *sym, void *proc)
+{
+    GLProcCacheEntry *slot;
+
+    if ((GLProcCacheUsed + 1) * 2 > GLProcCacheSize) {  /* keep it at most half full. */
+        const int newsize = GLProcCacheSize ? (GLProcCacheSize * 2) : 256;
+        GLProcCacheEntry *newcache = (GLProcCacheEntry *) SDL20_calloc(newsize, sizeof (GLProcCacheEntry));
+        int i;
+
+        if (!newcache) {
+            return;
+        }
+
+        for (i = 0; i < GLProcCacheSize; i++) {
+            if (GLProcCache[i].name) {
+                slot = FindGLProcCacheSlot(newcache, newsize, GLProcCache[i].hash, GLProcCache[i].name);
+                SDL20_memcpy(slot, &GLProcCache[i], sizeof (GLProcCacheEntry));
+            }
+        }
+        SDL20_free(GLProcCache);
+        GLProcCache = newcache;
+        GLProcCacheSize = newsize;
     }
-    if ((SDL20_strcmp(sym, "glCopyTexImage1D") == 0)) {
-        return (void *) glCopyTexImage1D_shim_for_scaling;
+
+    slot = FindGLProcCacheSlot(GLProcCache, GLProcCacheSize, hash, sym);
+    if (!slot->name) {  /* another thread might have beaten us to it. */
+        slot->name = SDL20_strdup(sym);
+        if (slot->name) {
+            slot->hash = hash;
+            slot->proc = proc;
+            GLProcCacheUsed++;
+        }
     }
-    if ((SDL20_strcmp(sym, "glCopyTexSubImage1D") == 0)) {
-        return (void *) glCopyTexSubImage1D_shim_for_scaling;
+}
+
+DECLSPEC12 void * SDLCALL
+SDL_GL_GetProcAddress(const char *sym)
+{
+    size_t len;
+    const Uint32 hash = HashGLProcName(sym, &len);
+    void *proc = NULL;
+    SDL_bool found = SDL_FALSE;
+
+    SDL20_AtomicLock(&GLProcCacheLock);
+    if (GLProcCacheContext != VideoGLContext20) {  /* context changed under us? Start over. */
+        ClearGLProcCacheLocked();
+        GLProcCacheContext = VideoGLContext20;
     }
-    if ((SDL20_strcmp(sym, "glCopyTexImage2D") == 0)) {
-        return (void *) glCopyTexImage2D_shim_for_scaling;
+    if (GLProcCache) {
+        const GLProcCacheEntry *slot = FindGLProcCacheSlot(GLProcCache, GLProcCacheSize, hash, sym);
+        if (slot->name) {
+            proc = slot->proc;
+            found = SDL_TRUE;
+        }
     }
-    if ((SDL20_strcmp(sym, "glCopyTexSubImage2D") == 0)) {
-        return (void *) glCopyTexSubImage2D_shim_for_scaling;
+    SDL20_AtomicUnlock(&GLProcCacheLock);
+
+    if (found) {
+        return proc;
     }
-    if ((SDL20_strcmp(sym, "glCopyTexSubImage3D") == 0)) {
-        return (void *) glCopyTexSubImage3D_shim_for_scaling;
+
+    proc = FindGLProcShim(sym, len);
+    if (!proc) {
+        proc = SDL20_GL_GetProcAddress(sym);
     }
 
-    /* this function is specific to the shim library */
-    if ((SDL20_strcmp(sym, "SDL12COMPAT_GetWindow") == 0)) {
-        return (void *) SDL12COMPAT_GetWindow;
+    if (proc) {
+        SDL20_AtomicLock(&GLProcCacheLock);
+        if (GLProcCacheContext == VideoGLContext20) {
+            AddGLProcCacheEntryLocked(hash, sym, proc);
+        }
+        SDL20_AtomicUnlock(&GLProcCacheLock);
     }
-    return SDL20_GL_GetProcAddress(sym);
+
+    return proc;
 }
 
 DECLSPEC12 int SDLCALL
@@ -8488,6 +11710,7 @@ SDL_GL_SwapBuffers(void)
             }
             OpenGLFuncs.glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGLCurrentReadFBO);
             OpenGLFuncs.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OpenGLCurrentDrawFBO);
+            OpenGLLogicalScalingMultisampleDirty = SDL_TRUE;  /* the next frame is coming, and we can't see most draws. */
         } else {
             SDL20_GL_SwapWindow(VideoWindow20);
         }
@@ -8599,6 +11822,7 @@ SDL_SetTimer(Uint32 interval, SDL12_TimerCallback callback)
     }
 
     if (interval && callback) {
+        NoteAppThreadCreated();  /* timer callbacks run on another thread, and some apps draw from them. */
         interval = RoundTimerTo12Resolution(interval);
         compat_timer = SDL20_AddTimer(interval, SetTimerCallback12, (void*)callback);
         if (!compat_timer) {
@@ -8647,6 +11871,9 @@ SDL_putenv(const char *_var)
 
     *ptr = '\0';  /* split the string into name and value. */
     SDL12COMPAT_setenv_unsafe(var, ptr + 1);
+    if (SDL20_strncmp(var, "SDL12COMPAT_", 12) == 0) {
+        RefreshHintConfig();  /* one of ours changed, update the snapshot. */
+    }
     SDL20_free(var);
     return 0;
 }
@@ -8670,12 +11897,14 @@ SDL_putenv(const char *_var)
 DECLSPEC12 SDL_Thread * SDLCALL
 SDL_CreateThread(int (SDLCALL *fn)(void *), void *data)
 {
+    NoteAppThreadCreated();
     return SDL20_CreateThread(fn, NULL, data, NULL, NULL);
 }
 #else
 DECLSPEC12 SDL_Thread * SDLCALL
 SDL_CreateThread(int (SDLCALL *fn)(void *), void *data, pfnSDL_CurrentBeginThread pfnBeginThread, pfnSDL_CurrentEndThread pfnEndThread)
 {
+    NoteAppThreadCreated();
     return SDL20_CreateThread(fn, NULL, data, pfnBeginThread, pfnEndThread);
 }
 #endif
@@ -8683,6 +11912,7 @@ SDL_CreateThread(int (SDLCALL *fn)(void *), void *data, pfnSDL_CurrentBeginThrea
 DECLSPEC12 SDL_Thread * SDLCALL
 SDL_CreateThread(int (SDLCALL *fn)(void *), void *data)
 {
+    NoteAppThreadCreated();
     return SDL20_CreateThread(fn, NULL, data);
 }
 #endif
@@ -8734,6 +11964,7 @@ SDL_AddTimer(Uint32 interval, SDL12_NewTimerCallback callback, void *param)
         return NULL;
     }
 
+    NoteAppThreadCreated();  /* timer callbacks run on another thread, and some apps draw from them. */
     interval = RoundTimerTo12Resolution(interval);
     data->callback = callback;
     data->param = param;
@@ -9060,7 +12291,10 @@ DECLSPEC12 int SDLCALL
 SDL_SaveBMP_RW(SDL12_Surface *surface12, SDL12_RWops *rwops12, int freerwops12)
 {
     SDL_RWops *rwops20 = RWops12to20(rwops12);
-    const int retval = SDL20_SaveBMP_RW(surface12->surface20, rwops20, freerwops12);
+    int retval;
+
+    SurfaceWillBeRead12(surface12);
+    retval = SDL20_SaveBMP_RW(surface12->surface20, rwops20, freerwops12);
     if (!freerwops12) {  /* free our wrapper if SDL2 didn't close it. */
         SDL20_FreeRW(rwops20);
     }
@@ -9161,6 +12395,9 @@ static SDL_INLINE size_t SDLCALL SDL20_RWread(SDL_RWops *ctx, void *ptr, size_t
 static SDL_INLINE int SDLCALL SDL20_RWclose(SDL_RWops *ctx) {
     return ctx->close(ctx);
 }
+static SDL_INLINE Sint64 SDLCALL SDL20_RWsize(SDL_RWops *ctx) {
+    return ctx->size(ctx);
+}
 
 static size_t
 mp3_sdlrwops_read(void *data, void *buf, size_t bytesToRead)
@@ -9188,54 +12425,383 @@ mp3_sdlrwops_seek(void *data, int offset, drmp3_seek_origin origin)
     return (SDL20_RWseek((SDL_RWops *) data, offset, whence) == -1) ? DRMP3_FALSE : DRMP3_TRUE;
 }
 
-static drmp3_bool32
-mp3_sdlrwops_tell(void *data, drmp3_int64 *pos)
+static drmp3_bool32
+mp3_sdlrwops_tell(void *data, drmp3_int64 *pos)
+{
+    *pos = SDL20_RWtell((SDL_RWops *) data);
+    return (*pos != -1) ? DRMP3_TRUE : DRMP3_FALSE;
+}
+
+/* Old games almost always want 11025 or 22050Hz audio, and the device runs
+   at 44100Hz or better, so the rate conversion is usually an exact 2x or 4x
+   (or 3x, for 16000Hz on a 48000Hz device), and now and then a 44100Hz
+   sound goes to a 22050Hz or 11025Hz device. We handle anything from 2x to
+   INTEGER_RESAMPLER_MAX_RATIO, up or down.
+   If SDL12COMPAT_INTEGER_RESAMPLING is enabled, the SDL_AudioStream only
+   converts format and channels (to float32 at the source rate), and we do
+   the rate conversion ourselves with a polyphase FIR filter (a Kaiser-windowed
+   sinc), which is both cheaper and cleaner than SDL2's general-purpose
+   resampler. */
+#define INTEGER_RESAMPLER_MAX_RATIO 4
+#define INTEGER_RESAMPLER_MAX_CHANNELS 8
+#define INTEGER_RESAMPLER_TAPS 16  /* per output phase. */
+#define INTEGER_RESAMPLER_CUTOFF 0.90
+#define INTEGER_RESAMPLER_BETA 8.0
+#define INTEGER_RESAMPLER_BLOCK 256  /* input frames per pass. */
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define INTEGER_RESAMPLER_SSE 1
+#include <xmmintrin.h>
+#endif
+typedef struct
+{
+    int up;  /* output frames per input frame; zero if not in use, and the SDL_AudioStream does everything. */
+    int down;  /* input frames per output frame. One of up and down is always 1. */
+    int taps;  /* per output phase. */
+    int histlen;  /* frames of older input that the filters reach back into. */
+    Uint8 channels;
+    SDL_AudioFormat dstfmt;  /* always AUDIO_F32SYS or AUDIO_S16SYS */
+    float coefficients[INTEGER_RESAMPLER_MAX_RATIO * INTEGER_RESAMPLER_TAPS];  /* oldest input first; [phase][tap] when upsampling. */
+    float *buffer;  /* a block of interleaved float32 input, from the SDL_AudioStream. */
+    float *planar;  /* per channel: histlen frames of history, then the same block, deinterleaved. */
+} IntegerResampler;
+
+static SDL_bool OpenSDL2AudioDevice(SDL_AudioSpec *want);
+static int CloseSDL2AudioDevice(void);
+static SDL_bool ResetAudioStream(SDL_AudioStream **_stream, IntegerResampler *resampler, SDL_AudioSpec *spec, const SDL_AudioSpec *to, const SDL_AudioFormat fromfmt, const Uint8 fromchannels, const int fromfreq);
+static int AudioStreamAvailableResampled(SDL_AudioStream *stream, const IntegerResampler *resampler);
+static int AudioStreamGetResampled(SDL_AudioStream *stream, IntegerResampler *resampler, void *buf, int len);
+
+/* Fake CD tracks can be MP3 files, or uncompressed PCM (a .wav file, or a
+   .raw file of CD-DA style 44.1KHz, 16-bit, stereo little-endian samples).
+   Uncompressed tracks are read straight from disk without any decoding, and
+   if they already match the audio device's format, they skip the
+   SDL_AudioStream entirely. */
+typedef enum
+{
+    CDTRACK_MP3,
+    CDTRACK_WAV,
+    CDTRACK_RAW,
+    CDTRACK_NUMTYPES
+} CDTrackFileType;
+
+typedef struct
+{
+    drmp3 mp3;  /* only used for MP3 tracks. */
+    SDL_RWops *pcm;  /* non-NULL for uncompressed tracks. */
+    SDL_AudioFormat format;  /* what we read from the track; MP3s always decode to float32. */
+    Uint8 channels;
+    int freq;
+    Sint64 pcm_start;  /* file offset of the first sample frame. */
+    Uint32 pcm_framesize;
+    Uint64 pcm_frames;
+    Uint64 pcm_frames_left;
+    SDL_bool at_end;
+} CDTrackData;
+
+typedef struct
+{
+    SDL_AudioSpec device_format;
+
+    SDL_bool app_callback_opened;
+    SDL_AudioSpec app_callback_format;
+    SDL_AudioStream *app_callback_stream;
+    IntegerResampler app_callback_resampler;
+
+    SDL_bool cdrom_opened;
+    SDL_AudioSpec cdrom_format;
+    SDL_AudioStream *cdrom_stream;
+    IntegerResampler cdrom_resampler;
+
+    SDL12_CDstatus cdrom_status;
+    int cdrom_pcm_frames_written;
+    int cdrom_cur_track;
+    int cdrom_cur_frame;
+    int cdrom_stop_ntracks;
+    int cdrom_stop_nframes;
+    CDTrackData cdrom_track;
+
+    Uint8 *mix_buffer;
+    size_t mixbuflen;
+
+    /* how much app audio was left buffered in app_callback_stream after each device callback, for latency reporting. */
+    Uint64 latency_fifo_total;
+    Uint32 latency_fifo_max;
+    Uint32 latency_callbacks;
+} AudioCallbackWrapperData;
+
+static AudioCallbackWrapperData *audio_cbdata = NULL;
+static SDL_atomic_t audio_callback_paused;
+
+/* SDL_CDStatus is called every frame by lots of games, so rather than
+   making them fight the audio thread for the device lock, we publish
+   status/track/frame here with a sequence counter (a "seqlock").
+   Writers always hold the audio lock (or are the audio callback), so
+   there is only ever one writer at a time. The counter is odd while
+   an update is in progress; readers retry if it's odd or changed.
+   This lives outside of audio_cbdata on purpose: readers don't take the
+   audio lock, so they must never touch anything that SDL_CloseAudio
+   might free out from under them. */
+static SDL_atomic_t CDStatusSequence;
+static SDL_atomic_t CDStatusValid;
+static SDL_atomic_t CDStatusStatus;
+static SDL_atomic_t CDStatusTrack;
+static SDL_atomic_t CDStatusFrame;
+
+/* call this with the audio device locked (or from the audio callback)! */
+static void
+PublishCDStatus(AudioCallbackWrapperData *data)
+{
+    SDL20_AtomicAdd(&CDStatusSequence, 1);  /* now odd: update in progress. */
+    SDL20_AtomicSet(&CDStatusValid, 1);
+    SDL20_AtomicSet(&CDStatusStatus, (int) data->cdrom_status);
+    SDL20_AtomicSet(&CDStatusTrack, data->cdrom_cur_track);
+    SDL20_AtomicSet(&CDStatusFrame, data->cdrom_cur_frame);
+    SDL20_AtomicAdd(&CDStatusSequence, 1);  /* even again: update is done. */
+}
+
+/* call this once the audio callback can't run anymore. */
+static void
+UnpublishCDStatus(void)
+{
+    SDL20_AtomicAdd(&CDStatusSequence, 1);
+    SDL20_AtomicSet(&CDStatusValid, 0);
+    SDL20_AtomicAdd(&CDStatusSequence, 1);
+}
+
+
+static void
+FreeMp3(drmp3 *mp3)
+{
+    SDL_RWops *rw = (SDL_RWops *) mp3->pUserData;
+    if (rw) {
+        drmp3_uninit(mp3);
+        mp3->pUserData = NULL;
+        SDL20_RWclose(rw);
+    }
+}
+
+static SDL_bool
+CDTrackIsOpen(const CDTrackData *track)
+{
+    return (track->pcm || track->mp3.pUserData) ? SDL_TRUE : SDL_FALSE;
+}
+
+static void
+CloseCDTrack(CDTrackData *track)
+{
+    FreeMp3(&track->mp3);
+    if (track->pcm) {
+        SDL20_RWclose(track->pcm);
+        track->pcm = NULL;
+    }
+}
+
+static SDL_bool
+ReadLE16FromRW(SDL_RWops *rw, Uint16 *val)
+{
+    Uint8 b[2];
+    if (SDL20_RWread(rw, b, sizeof (b), 1) != 1) {
+        return SDL_FALSE;
+    }
+    *val = (Uint16) (((Uint16) b[0]) | (((Uint16) b[1]) << 8));
+    return SDL_TRUE;
+}
+
+static SDL_bool
+ReadLE32FromRW(SDL_RWops *rw, Uint32 *val)
+{
+    Uint8 b[4];
+    if (SDL20_RWread(rw, b, sizeof (b), 1) != 1) {
+        return SDL_FALSE;
+    }
+    *val = ((Uint32) b[0]) | (((Uint32) b[1]) << 8) | (((Uint32) b[2]) << 16) | (((Uint32) b[3]) << 24);
+    return SDL_TRUE;
+}
+
+/* We only need to find the "fmt " and "data" chunks, and we only accept the
+   sort of thing you'd get ripping a CD: integer PCM or float32, no compression. */
+static SDL_bool
+InitWavCDTrack(CDTrackData *track)
+{
+    SDL_RWops *rw = track->pcm;
+    SDL_bool have_fmt = SDL_FALSE;
+    Uint32 riff, wave, chunkid, chunklen;
+    Uint16 tag = 0, channels = 0, blockalign = 0, bits = 0;
+    Uint32 freq = 0;
+
+    if (!ReadLE32FromRW(rw, &riff) || !ReadLE32FromRW(rw, &chunklen) || !ReadLE32FromRW(rw, &wave)) {
+        return SDL_FALSE;
+    } else if ((riff != 0x46464952) || (wave != 0x45564157)) {  /* "RIFF", "WAVE" */
+        return SDL_FALSE;
+    }
+
+    while (ReadLE32FromRW(rw, &chunkid) && ReadLE32FromRW(rw, &chunklen)) {
+        const Sint64 chunkstart = SDL20_RWtell(rw);
+        if (chunkid == 0x20746D66) {  /* "fmt " */
+            Uint32 byterate;
+            if ((chunklen < 16) || !ReadLE16FromRW(rw, &tag) || !ReadLE16FromRW(rw, &channels) ||
+                !ReadLE32FromRW(rw, &freq) || !ReadLE32FromRW(rw, &byterate) ||
+                !ReadLE16FromRW(rw, &blockalign) || !ReadLE16FromRW(rw, &bits)) {
+                return SDL_FALSE;
+            }
+            if ((tag == 0xFFFE) && (chunklen >= 40)) {  /* WAVE_FORMAT_EXTENSIBLE: the real tag is the start of the subformat GUID. */
+                if ((SDL20_RWseek(rw, chunkstart + 24, RW_SEEK_SET) == -1) || !ReadLE16FromRW(rw, &tag)) {
+                    return SDL_FALSE;
+                }
+            }
+            have_fmt = SDL_TRUE;
+        } else if (chunkid == 0x61746164) {  /* "data" */
+            if (!have_fmt) {
+                return SDL_FALSE;
+            }
+
+            if ((tag == 1) && (bits == 8)) {
+                track->format = AUDIO_U8;
+            } else if ((tag == 1) && (bits == 16)) {
+                track->format = AUDIO_S16LSB;
+            } else if ((tag == 1) && (bits == 32)) {
+                track->format = AUDIO_S32LSB;
+            } else if ((tag == 3) && (bits == 32)) {
+                track->format = AUDIO_F32LSB;
+            } else {
+                return SDL_FALSE;  /* compressed, 24-bit, etc. Convert it to something else. */
+            }
+
+            if ((channels == 0) || (channels > 8) || (freq == 0) || (blockalign != (channels * (bits / 8)))) {
+                return SDL_FALSE;
+            }
+
+            track->channels = (Uint8) channels;
+            track->freq = (int) freq;
+            track->pcm_framesize = blockalign;
+            track->pcm_start = chunkstart;
+            track->pcm_frames = chunklen / blockalign;
+            return SDL_TRUE;
+        }
+
+        /* chunks are padded to an even number of bytes. */
+        if (SDL20_RWseek(rw, chunkstart + chunklen + (chunklen & 1), RW_SEEK_SET) == -1) {
+            break;
+        }
+    }
+
+    return SDL_FALSE;
+}
+
+/* Takes ownership of (rw), even on failure. */
+static SDL_bool
+InitCDTrack(CDTrackData *track, SDL_RWops *rw, const CDTrackFileType type)
+{
+    SDL20_zerop(track);
+
+    if (type == CDTRACK_MP3) {
+        if (!drmp3_init(&track->mp3, mp3_sdlrwops_read, mp3_sdlrwops_seek, mp3_sdlrwops_tell, NULL, rw, NULL)) {
+            SDL20_RWclose(rw);
+            return SDL_FALSE;
+        }
+        track->format = AUDIO_F32SYS;
+        track->channels = (Uint8) track->mp3.channels;
+        track->freq = (int) track->mp3.sampleRate;
+        return SDL_TRUE;
+    }
+
+    track->pcm = rw;
+    if (type == CDTRACK_WAV) {
+        if (!InitWavCDTrack(track)) {
+            CloseCDTrack(track);
+            return SDL_FALSE;
+        }
+    } else {
+        const Sint64 len = SDL20_RWsize(rw);
+        SDL_assert(type == CDTRACK_RAW);
+        if (len <= 0) {
+            CloseCDTrack(track);
+            return SDL_FALSE;
+        }
+        track->format = AUDIO_S16LSB;
+        track->channels = 2;
+        track->freq = 44100;
+        track->pcm_framesize = 4;
+        track->pcm_start = 0;
+        track->pcm_frames = ((Uint64) len) / 4;
+    }
+
+    track->pcm_frames_left = track->pcm_frames;
+    if (SDL20_RWseek(rw, track->pcm_start, RW_SEEK_SET) == -1) {
+        CloseCDTrack(track);
+        return SDL_FALSE;
+    }
+
+    return SDL_TRUE;
+}
+
+/* (tracknum) is one-based here, like the filenames. Returns NULL if there's no such file. */
+static SDL_RWops *
+OpenCDTrackFile(const int tracknum, CDTrackFileType *type)
+{
+    static const char *extensions[CDTRACK_NUMTYPES] = { "mp3", "wav", "raw" };
+    const size_t alloclen = SDL20_strlen(CDRomPath) + 32;
+    char *fullpath = (char *) SDL20_malloc(alloclen);
+    SDL_RWops *rw = NULL;
+    const char c0 = tracknum / 10 + '0';
+    const char c1 = tracknum % 10 + '0';
+    int i;
+
+    if (!fullpath) {
+        return NULL;
+    }
+
+    for (i = 0; (rw == NULL) && (i < (int) SDL_arraysize(extensions)); i++) {
+        SDL20_snprintf(fullpath, alloclen, "%s%strack%c%c.%s", CDRomPath, DIRSEP, c0, c1, extensions[i]);
+        rw = SDL20_RWFromFile(fullpath, "rb");
+        *type = (CDTrackFileType) i;
+    }
+
+    SDL20_free(fullpath);
+    return rw;
+}
+
+static Uint64
+GetCDTrackFrameCount(CDTrackData *track)
 {
-    *pos = SDL20_RWtell((SDL_RWops *) data);
-    return (*pos != -1) ? DRMP3_TRUE : DRMP3_FALSE;
+    return track->pcm ? track->pcm_frames : (Uint64) drmp3_get_pcm_frame_count(&track->mp3);
 }
 
-static SDL_bool OpenSDL2AudioDevice(SDL_AudioSpec *want);
-static int CloseSDL2AudioDevice(void);
-static SDL_bool ResetAudioStream(SDL_AudioStream **_stream, SDL_AudioSpec *spec, const SDL_AudioSpec *to, const SDL_AudioFormat fromfmt, const Uint8 fromchannels, const int fromfreq);
-
-typedef struct
+static void
+SeekCDTrack(CDTrackData *track, Uint64 pcm_frame)
 {
-    SDL_AudioSpec device_format;
-
-    SDL_bool app_callback_opened;
-    SDL_AudioSpec app_callback_format;
-    SDL_AudioStream *app_callback_stream;
-
-    SDL_bool cdrom_opened;
-    SDL_AudioSpec cdrom_format;
-    SDL_AudioStream *cdrom_stream;
-
-    SDL12_CDstatus cdrom_status;
-    int cdrom_pcm_frames_written;
-    int cdrom_cur_track;
-    int cdrom_cur_frame;
-    int cdrom_stop_ntracks;
-    int cdrom_stop_nframes;
-    drmp3 cdrom_mp3;
+    if (!track->pcm) {
+        drmp3_seek_to_pcm_frame(&track->mp3, (drmp3_uint64) pcm_frame);
+        return;
+    }
 
-    Uint8 *mix_buffer;
-    size_t mixbuflen;
-} AudioCallbackWrapperData;
+    if (pcm_frame > track->pcm_frames) {
+        pcm_frame = track->pcm_frames;
+    }
+    if (SDL20_RWseek(track->pcm, track->pcm_start + (Sint64) (pcm_frame * track->pcm_framesize), RW_SEEK_SET) == -1) {
+        track->pcm_frames_left = 0;  /* just treat it like the end of the track. */
+    } else {
+        track->pcm_frames_left = track->pcm_frames - pcm_frame;
+    }
+}
 
-static AudioCallbackWrapperData *audio_cbdata = NULL;
-static SDL_atomic_t audio_callback_paused;
+/* reads up to (frames) sample frames in (track->format); returns number of frames read. */
+static Uint32
+ReadCDTrack(CDTrackData *track, void *buf, Uint32 frames)
+{
+    size_t br;
 
+    if (!track->pcm) {
+        return (Uint32) drmp3_read_pcm_frames_f32(&track->mp3, frames, (float *) buf);
+    }
 
-static void
-FreeMp3(drmp3 *mp3)
-{
-    SDL_RWops *rw = (SDL_RWops *) mp3->pUserData;
-    if (rw) {
-        drmp3_uninit(mp3);
-        mp3->pUserData = NULL;
-        SDL20_RWclose(rw);
+    if (((Uint64) frames) > track->pcm_frames_left) {
+        frames = (Uint32) track->pcm_frames_left;
     }
+    br = SDL20_RWread(track->pcm, buf, 1, frames * track->pcm_framesize);
+    frames = (Uint32) (br / track->pcm_framesize);
+    track->pcm_frames_left -= frames;
+    return frames;
 }
 
 
@@ -9253,16 +12819,11 @@ CDSubsystemIsInitialized(void)
 static void
 InitializeCDSubsystem(void)
 {
-    const char *cdpath;
-
     if (CDRomInit) {
         return;
     }
 
-    cdpath = SDL12Compat_GetHint("SDL12COMPAT_FAKE_CDROM_PATH");
-    if (cdpath) {
-        CDRomPath = SDL_strdup(cdpath);
-    }
+    CDRomPath = DupHintString(&GetHintConfig()->fake_cdrom_path);
 
     CDRomInit = SDL_TRUE;
 }
@@ -9292,7 +12853,7 @@ SDL_CDNumDrives(void)
             SDL20_Log("This app is looking for CD-ROM drives, but no path was specified");
             SDL20_Log("Set the SDL12COMPAT_FAKE_CDROM_PATH environment variable to a directory");
             SDL20_Log("of MP3 files named trackXX.mp3 where XX is a track number in two digits");
-            SDL20_Log("from 01 to 99");
+            SDL20_Log("from 01 to 99 (uncompressed trackXX.wav or trackXX.raw files work, too)");
         }
     }
 
@@ -9326,7 +12887,7 @@ SDL_CDOpen(int drive)
     SDL12_CD *retval;
     size_t alloclen;
     char *fullpath;
-    drmp3 *mp3 = NULL;
+    CDTrackData *trackdata = NULL;
     Uint32 total_track_offset = 0;
     SDL_bool has_audio = SDL_FALSE;
 
@@ -9348,8 +12909,8 @@ SDL_CDOpen(int drive)
         return NULL;
     }
 
-    mp3 = (drmp3 *) SDL20_malloc(sizeof (drmp3));
-    if (!mp3) {
+    trackdata = (CDTrackData *) SDL20_malloc(sizeof (CDTrackData));
+    if (!trackdata) {
         SDL20_free(fullpath);
         SDL20_free(retval);
         SDL20_OutOfMemory();
@@ -9363,8 +12924,9 @@ SDL_CDOpen(int drive)
        and then stop. */
     for (;;) {
         SDL_RWops *rw;
-        drmp3_uint64 pcmframes;
-        drmp3_uint32 samplerate;
+        CDTrackFileType type;
+        Uint64 pcmframes;
+        int samplerate;
         SDL12_CDtrack *track;
         SDL_bool fake_data_track = SDL_FALSE;
         int c;
@@ -9382,8 +12944,7 @@ SDL_CDOpen(int drive)
             SDL20_RWclose(rw);
             rw = NULL;
         } else {
-            SDL20_snprintf(fullpath, alloclen, "%s%strack%c%c.mp3", CDRomPath, DIRSEP, c0, c1);
-            rw = SDL20_RWFromFile(fullpath, "rb");
+            rw = OpenCDTrackFile(c, &type);
             /* if there isn't a track 1 specified, pretend it's a data track, which matches most games' needs. */
             if (!rw && (c == 1)) {
                 fake_data_track = SDL_TRUE;
@@ -9396,14 +12957,13 @@ SDL_CDOpen(int drive)
         track = &retval->track[retval->numtracks];
         if (!fake_data_track) {
             SDL_assert(rw != NULL);
-            if (!drmp3_init(mp3, mp3_sdlrwops_read, mp3_sdlrwops_seek, mp3_sdlrwops_tell, NULL, rw, NULL)) {
-                SDL20_RWclose(rw);
+            if (!InitCDTrack(trackdata, rw, type)) {  /* this closes (rw) on failure. */
                 rw = NULL;
-                fake_data_track = SDL_TRUE; /* congratulations, bogus or unsupported MP3, you just became data! */
+                fake_data_track = SDL_TRUE; /* congratulations, bogus or unsupported audio file, you just became data! */
             } else {
-                pcmframes = drmp3_get_pcm_frame_count(mp3);
-                samplerate = mp3->sampleRate;
-                FreeMp3(mp3);
+                pcmframes = GetCDTrackFrameCount(trackdata);  /* this is O(1) for uncompressed tracks, but MP3s have to be scanned. */
+                samplerate = trackdata->freq;
+                CloseCDTrack(trackdata);
                 rw = NULL;
 
                 track->id = retval->numtracks;
@@ -9432,7 +12992,7 @@ SDL_CDOpen(int drive)
     if (!has_audio) {
         retval->numtracks = 0; /* data-only */
     }
-    SDL20_free(mp3);
+    SDL20_free(trackdata);
     SDL20_free(fullpath);
 
     retval->id = 1;  /* just to be non-zero, I guess. */
@@ -9457,6 +13017,7 @@ SDL_CDOpen(int drive)
             audio_cbdata->cdrom_pcm_frames_written = 0;
             audio_cbdata->cdrom_cur_track = 0;
             audio_cbdata->cdrom_cur_frame = 0;
+            PublishCDStatus(audio_cbdata);
             SDL20_UnlockAudio();
         }
     }
@@ -9485,55 +13046,50 @@ ValidCDDevice(SDL12_CD *cdrom)
 DECLSPEC12 SDL12_CDstatus SDLCALL
 SDL_CDStatus(SDL12_CD *cdrom)
 {
-    SDL12_CDstatus retval;
+    int valid, status, track, frame, sequence;
 
     if ((cdrom = ValidCDDevice(cdrom)) == NULL) {
         return SDL12_CD_ERROR;
     }
 
-    SDL20_LockAudio();  /* we update this during the audio callback. */
-    if (audio_cbdata) {
-        cdrom->status = audio_cbdata->cdrom_status;
-        cdrom->cur_track = audio_cbdata->cdrom_cur_track;
-        cdrom->cur_frame = audio_cbdata->cdrom_cur_frame;
+    /* we update this during the audio callback, but we don't take the
+       audio lock here; see PublishCDStatus(). Writers only hold the
+       sequence odd for a few instructions, so just spin until we get a
+       consistent snapshot. */
+    do {
+        sequence = SDL20_AtomicGet(&CDStatusSequence);
+        valid = SDL20_AtomicGet(&CDStatusValid);
+        status = SDL20_AtomicGet(&CDStatusStatus);
+        track = SDL20_AtomicGet(&CDStatusTrack);
+        frame = SDL20_AtomicGet(&CDStatusFrame);
+    } while ((sequence & 1) || (sequence != SDL20_AtomicGet(&CDStatusSequence)));
+
+    if (valid) {
+        cdrom->status = (SDL12_CDstatus) status;
+        cdrom->cur_track = track;
+        cdrom->cur_frame = frame;
     }
-    retval = cdrom->status;
-    SDL20_UnlockAudio();
 
-    return retval;
+    return cdrom->status;
 }
 
 static SDL_bool
-LoadCDTrack(const int tracknum, drmp3 *mp3)
+LoadCDTrack(const int tracknum, CDTrackData *track)
 {
     const SDL_AudioSpec *have = &audio_cbdata->device_format;
-    SDL_RWops *rw = NULL;
-    const size_t alloclen = SDL20_strlen(CDRomPath) + 32;
-    char *fullpath = (char *) SDL_malloc(alloclen);
-    const int c = tracknum + 1;
-    char c0, c1;
-
-    if (!fullpath) {
-        return SDL_FALSE;
-    }
-
-    c0 = c / 10 + '0';
-    c1 = c % 10 + '0';
-    SDL20_snprintf(fullpath, alloclen, "%s%strack%c%c.mp3", CDRomPath, DIRSEP, c0, c1);
-    rw = SDL20_RWFromFile(fullpath, "rb");
-    SDL20_free(fullpath);
+    CDTrackFileType type;
+    SDL_RWops *rw = OpenCDTrackFile(tracknum + 1, &type);
 
     if (!rw) {
         return SDL_FALSE;
     }
 
-    if (!drmp3_init(mp3, mp3_sdlrwops_read, mp3_sdlrwops_seek, mp3_sdlrwops_tell, NULL, rw, NULL)) {
-        SDL20_RWclose(rw);
+    if (!InitCDTrack(track, rw, type)) {
         return SDL_FALSE;
     }
 
-    if (!ResetAudioStream(&audio_cbdata->cdrom_stream, &audio_cbdata->cdrom_format, have, AUDIO_F32SYS, mp3->channels, mp3->sampleRate)) {
-        FreeMp3(mp3);
+    if (!ResetAudioStream(&audio_cbdata->cdrom_stream, &audio_cbdata->cdrom_resampler, &audio_cbdata->cdrom_format, have, track->format, track->channels, track->freq)) {
+        CloseCDTrack(track);
         return SDL_FALSE;
     }
 
@@ -9543,17 +13099,17 @@ LoadCDTrack(const int tracknum, drmp3 *mp3)
 static int
 StartCDAudioPlaying(SDL12_CD *cdrom, const int start_track, const int start_frame, const int ntracks, const int nframes)
 {
-    drmp3 *mp3 = (drmp3 *) SDL20_malloc(sizeof (drmp3));
-    const SDL_bool loaded = mp3 ? LoadCDTrack(start_track, mp3) : SDL_FALSE;
+    CDTrackData *track = (CDTrackData *) SDL20_malloc(sizeof (CDTrackData));
+    const SDL_bool loaded = track ? LoadCDTrack(start_track, track) : SDL_FALSE;
     const SDL_bool seeking = (loaded && (start_frame > 0))? SDL_TRUE : SDL_FALSE;
-    const drmp3_uint32 pcm_frame = seeking ? (Uint32) ((start_frame / 75.0) * (Sint32)mp3->sampleRate) : 0;
+    const Uint32 pcm_frame = seeking ? (Uint32) ((start_frame / 75.0) * track->freq) : 0;
 
-    if (!mp3) {
+    if (!track) {
         return SDL20_OutOfMemory();
     }
 
     if (seeking) {   /* do seeking before handing off to the audio thread. */
-        drmp3_seek_to_pcm_frame(mp3, pcm_frame);
+        SeekCDTrack(track, pcm_frame);
     }
 
     SDL20_LockAudio();
@@ -9564,14 +13120,15 @@ StartCDAudioPlaying(SDL12_CD *cdrom, const int start_track, const int start_fram
         audio_cbdata->cdrom_cur_frame = start_frame;
         audio_cbdata->cdrom_stop_ntracks = ntracks;
         audio_cbdata->cdrom_stop_nframes = nframes;
-        FreeMp3(&audio_cbdata->cdrom_mp3);
+        CloseCDTrack(&audio_cbdata->cdrom_track);
         if (loaded) {
-            SDL20_memcpy(&audio_cbdata->cdrom_mp3, mp3, sizeof (drmp3));
+            SDL20_memcpy(&audio_cbdata->cdrom_track, track, sizeof (CDTrackData));
         }
+        PublishCDStatus(audio_cbdata);
     }
     SDL20_UnlockAudio();
 
-    SDL20_free(mp3);
+    SDL20_free(track);
 
     return loaded ? 0 : SDL20_SetError("Failed to start CD track");
 }
@@ -9683,6 +13240,7 @@ SDL_CDPause(SDL12_CD *cdrom)
     if (audio_cbdata) {
         if (audio_cbdata->cdrom_status == SDL12_CD_PLAYING) {
             audio_cbdata->cdrom_status = SDL12_CD_PAUSED;
+            PublishCDStatus(audio_cbdata);
         }
         cdrom->status = audio_cbdata->cdrom_status;
     }
@@ -9704,6 +13262,7 @@ SDL_CDResume(SDL12_CD *cdrom)
     if (audio_cbdata) {
         if (audio_cbdata->cdrom_status == SDL12_CD_PAUSED) {
             audio_cbdata->cdrom_status = SDL12_CD_PLAYING;
+            PublishCDStatus(audio_cbdata);
         }
         cdrom->status = audio_cbdata->cdrom_status;
     }
@@ -9725,7 +13284,8 @@ SDL_CDStop(SDL12_CD *cdrom)
     if (audio_cbdata) {
         if ((audio_cbdata->cdrom_status == SDL12_CD_PLAYING) || (audio_cbdata->cdrom_status == SDL12_CD_PAUSED)) {
             audio_cbdata->cdrom_status = SDL12_CD_STOPPED;
-            FreeMp3(&audio_cbdata->cdrom_mp3);
+            CloseCDTrack(&audio_cbdata->cdrom_track);
+            PublishCDStatus(audio_cbdata);
         }
         cdrom->status = audio_cbdata->cdrom_status;
     }
@@ -9747,7 +13307,8 @@ SDL_CDEject(SDL12_CD *cdrom)
     SDL20_LockAudio();
     if (audio_cbdata) {
         audio_cbdata->cdrom_status = SDL12_CD_TRAYEMPTY;
-        FreeMp3(&audio_cbdata->cdrom_mp3);
+        CloseCDTrack(&audio_cbdata->cdrom_track);
+        PublishCDStatus(audio_cbdata);
     }
     cdrom->status = SDL12_CD_TRAYEMPTY;
     SDL20_UnlockAudio();
@@ -9765,11 +13326,12 @@ SDL_CDClose(SDL12_CD *cdrom)
     if (audio_cbdata) {
         audio_cbdata->cdrom_status = SDL12_CD_STOPPED;
         audio_cbdata->cdrom_opened = SDL_FALSE;
+        PublishCDStatus(audio_cbdata);
     }
     SDL20_UnlockAudio();
 
     if (audio_cbdata) {
-        FreeMp3(&audio_cbdata->cdrom_mp3);
+        CloseCDTrack(&audio_cbdata->cdrom_track);
         SDL20_FreeAudioStream(audio_cbdata->cdrom_stream);
         audio_cbdata->cdrom_stream = NULL;
     }
@@ -9783,9 +13345,16 @@ SDL_CDClose(SDL12_CD *cdrom)
 }
 
 
+static SDL_bool
+CDTrackMatchesDevice(const CDTrackData *track, const SDL_AudioSpec *device_format)
+{
+    return (track->pcm && (track->format == device_format->format) && (track->channels == device_format->channels) && (track->freq == device_format->freq)) ? SDL_TRUE : SDL_FALSE;
+}
+
 static void
 FakeCdRomAudioCallback(AudioCallbackWrapperData *data, Uint8 *stream, int len, const SDL_bool must_mix)
 {
+    CDTrackData *track = &data->cdrom_track;
     Uint32 total_available, available = 0;
     Uint32 channels, want_frames;
 
@@ -9796,49 +13365,77 @@ FakeCdRomAudioCallback(AudioCallbackWrapperData *data, Uint8 *stream, int len, c
         return;
     }
 
-    SDL_assert((data->cdrom_status == SDL12_CD_PLAYING) && (data->cdrom_mp3.pUserData != NULL));
+    SDL_assert((data->cdrom_status == SDL12_CD_PLAYING) && CDTrackIsOpen(track));
 
-    channels = data->cdrom_format.channels;
-    want_frames = data->cdrom_format.samples / channels;
+    if (CDTrackMatchesDevice(track, &data->device_format)) {
+        /* Uncompressed track that's already in the device format (usually a
+           .raw rip on a 44.1KHz stereo S16 device): read it right into the
+           output, no SDL_AudioStream needed. */
+        const Uint32 framesize = track->pcm_framesize;
+        while ((!track->at_end) && (available < ((Uint32) len))) {
+            Uint8 *dst = must_mix ? data->mix_buffer : (stream + available);
+            Uint32 bytes = ((Uint32) len) - available;
+            Uint32 frames_read;
+            if (must_mix && (bytes > data->mixbuflen)) {
+                bytes = (Uint32) data->mixbuflen;
+            }
+            frames_read = ReadCDTrack(track, dst, bytes / framesize);
+            if (!frames_read) {
+                track->at_end = SDL_TRUE;
+                break;
+            }
+            bytes = frames_read * framesize;
+            if (must_mix) {
+                SDL20_MixAudioFormat(stream + available, data->mix_buffer, data->device_format.format, bytes, SDL_MIX_MAXVOLUME);
+            }
+            available += bytes;
+        }
+        total_available = 0;  /* nothing is left buffered on this path. */
+    } else {
+        channels = data->cdrom_format.channels;
+        want_frames = data->cdrom_format.samples / channels;
+
+        while ((!track->at_end) && (AudioStreamAvailableResampled(data->cdrom_stream, &data->cdrom_resampler) < len)) {
+            const Uint32 frames_read = ReadCDTrack(track, data->mix_buffer, want_frames);
+            const Uint32 bytes_read = frames_read * channels * (SDL_AUDIO_BITSIZE(track->format) / 8);
+            SDL_assert(bytes_read <= data->cdrom_format.size);
+            if ((!bytes_read) || (SDL20_AudioStreamPut(data->cdrom_stream, data->mix_buffer, bytes_read) == -1)) {  /* probably out of memory if failed */
+                track->at_end = SDL_TRUE;  /* force this to fail from now on */
+                SDL20_AudioStreamFlush(data->cdrom_stream);  /* make sure all we've put is available to get. */
+                break;
+            }
+        }
 
-    while ((!data->cdrom_mp3.atEnd) && (SDL20_AudioStreamAvailable(data->cdrom_stream) < len)) {
-        const Uint32 frames_read = (Uint32) drmp3_read_pcm_frames_f32(&data->cdrom_mp3, want_frames, (float *) data->mix_buffer);
-        const Uint32 bytes_read = frames_read * channels * sizeof (float);
-        SDL_assert(bytes_read <= data->cdrom_format.size);
-        if ((!bytes_read) || (SDL20_AudioStreamPut(data->cdrom_stream, data->mix_buffer, bytes_read) == -1)) {  /* probably out of memory if failed */
-            data->cdrom_mp3.atEnd = DRMP3_TRUE;  /* force this to fail from now on */
-            SDL20_AudioStreamFlush(data->cdrom_stream);  /* make sure all we've put is available to get. */
-            break;
+        total_available = AudioStreamAvailableResampled(data->cdrom_stream, &data->cdrom_resampler);
+        available = total_available;
+        if (((Uint32) len) < available) {
+            available = (Uint32) len;
         }
-    }
 
-    total_available = SDL20_AudioStreamAvailable(data->cdrom_stream);
-    available = total_available;
-    if (((Uint32) len) < available) {
-        available = (Uint32) len;
+        if (available > 0) {
+            if (!must_mix) {
+                AudioStreamGetResampled(data->cdrom_stream, &data->cdrom_resampler, stream, available);
+            } else {
+                AudioStreamGetResampled(data->cdrom_stream, &data->cdrom_resampler, data->mix_buffer, available);
+                SDL20_MixAudioFormat(stream, data->mix_buffer, audio_cbdata->device_format.format, available, SDL_MIX_MAXVOLUME);
+            }
+        }
     }
 
     if (available > 0) {
-        if (!must_mix) {
-            SDL20_AudioStreamGet(data->cdrom_stream, stream, available);
-        } else {
-            SDL20_AudioStreamGet(data->cdrom_stream, data->mix_buffer, available);
-            SDL20_MixAudioFormat(stream, data->mix_buffer, audio_cbdata->device_format.format, available, SDL_MIX_MAXVOLUME);
-        }
-
         data->cdrom_pcm_frames_written += (int) ((available / ((double) SDL_AUDIO_BITSIZE(data->device_format.format) / 8.0)) / data->device_format.channels);
         data->cdrom_cur_frame = (int) ((((double)data->cdrom_pcm_frames_written) / ((double)data->device_format.freq)) * CDAUDIO_FPS);
         if (data->cdrom_stop_ntracks == 0) {
             if (data->cdrom_cur_frame >= data->cdrom_stop_nframes) {
-                data->cdrom_mp3.atEnd = DRMP3_TRUE;  /* played all that was requested! */
+                track->at_end = SDL_TRUE;  /* played all that was requested! */
             }
         }
     }
 
-    if ((total_available == 0) && (data->cdrom_mp3.atEnd)) {  /* mp3 is done for whatever reason */
+    if ((total_available == 0) && (track->at_end)) {  /* track is done for whatever reason */
         SDL_bool silence = ((!must_mix) && (available < ((Uint32) len))) ? SDL_TRUE : SDL_FALSE;  /* silence any section we couldn't provide */
 
-        FreeMp3(&data->cdrom_mp3);
+        CloseCDTrack(track);
 
         if (data->cdrom_stop_ntracks > 0) {
             data->cdrom_stop_ntracks--;
@@ -9846,7 +13443,7 @@ FakeCdRomAudioCallback(AudioCallbackWrapperData *data, Uint8 *stream, int len, c
             data->cdrom_cur_frame = 0;
 
             if (data->cdrom_status == SDL12_CD_PLAYING) {  /* go on to next track? */
-                const SDL_bool loaded = LoadCDTrack(++data->cdrom_cur_track, &data->cdrom_mp3);
+                const SDL_bool loaded = LoadCDTrack(++data->cdrom_cur_track, track);
                 if (!loaded) {
                     data->cdrom_status = SDL12_CD_STOPPED;
                 } else {  /* let new track fill out rest of callback. */
@@ -9864,6 +13461,8 @@ FakeCdRomAudioCallback(AudioCallbackWrapperData *data, Uint8 *stream, int len, c
             SDL20_memset(stream + available, data->device_format.silence, len - available);
         }
     }
+
+    PublishCDStatus(data);
 }
 
 
@@ -9874,30 +13473,273 @@ AudioCallbackWrapper(void *userdata, Uint8 *stream, int len)
     SDL_bool must_mix = SDL_FALSE;
 
     if (data->app_callback_opened && !SDL20_AtomicGet(&audio_callback_paused)) {
-        while (SDL20_AudioStreamAvailable(data->app_callback_stream) < len) {
+        while (AudioStreamAvailableResampled(data->app_callback_stream, &data->app_callback_resampler) < len) {
             SDL20_memset(data->mix_buffer, data->app_callback_format.silence, data->app_callback_format.size);  /* SDL2 doesn't clear the stream before calling in here, but 1.2 expects it. */
             data->app_callback_format.callback(data->app_callback_format.userdata, data->mix_buffer, data->app_callback_format.size);
             if (SDL20_AudioStreamPut(data->app_callback_stream, data->mix_buffer, data->app_callback_format.size) == -1) {  /* probably out of memory if failed */
                 break;  /* this will make the AudioStreamGet call fail. */
             }
         }
-        if (SDL20_AudioStreamGet(data->app_callback_stream, stream, len) != len) {
+        if (AudioStreamGetResampled(data->app_callback_stream, &data->app_callback_resampler, stream, len) != len) {
             SDL20_memset(stream, data->device_format.silence, len);
         } else {
             must_mix = SDL_TRUE;
         }
+
+        {  /* measure what's left buffered, for SDL12COMPAT_GetAudioLatency() and debug logging. */
+            const Uint32 fifo = (Uint32) AudioStreamAvailableResampled(data->app_callback_stream, &data->app_callback_resampler);
+            data->latency_fifo_total += fifo;
+            data->latency_fifo_max = SDL_max(data->latency_fifo_max, fifo);
+            data->latency_callbacks++;
+        }
     }
 
     FakeCdRomAudioCallback(data, stream, len, must_mix);
 }
 
 
+/* zeroth-order modified Bessel function of the first kind, for the Kaiser window. */
+static double
+ResamplerBessel(const double x)
+{
+    const double xsquareddiv4 = (x * x) / 4.0;
+    double retval = 1.0;
+    double term = 1.0;
+    int k;
+
+    for (k = 1; k < 64; k++) {
+        term *= xsquareddiv4 / (((double) k) * ((double) k));
+        retval += term;
+        if (term < (retval * 1.0e-12)) {
+            break;
+        }
+    }
+    return retval;
+}
+
+static int
+IntegerResamplingRatio(const SDL_AudioSpec *to, const int fromfreq, int *up, int *down)
+{
+    *up = *down = 1;
+
+    if (!WantIntegerResampling || (fromfreq <= 0) || (to->freq <= 0)) {
+        return 0;
+    } else if ((to->format != AUDIO_F32SYS) && (to->format != AUDIO_S16SYS)) {
+        return 0;
+    } else if (to->channels > INTEGER_RESAMPLER_MAX_CHANNELS) {
+        return 0;
+    } else if ((to->freq % fromfreq) == 0) {
+        *up = to->freq / fromfreq;
+        if ((to->samples % *up) != 0) {
+            return 0;  /* we only produce whole groups of output frames; this lets us always fill the device's buffer exactly. */
+        }
+    } else if ((fromfreq % to->freq) == 0) {
+        *down = fromfreq / to->freq;
+    } else {
+        return 0;
+    }
+
+    return ((*up * *down) >= 2) && ((*up * *down) <= INTEGER_RESAMPLER_MAX_RATIO);
+}
+
+static SDL_bool
+ResetIntegerResampler(IntegerResampler *resampler, const SDL_AudioSpec *to, const int fromfreq)
+{
+    const int taps = INTEGER_RESAMPLER_TAPS;
+    int up, down, ratio, len, histlen, i;
+    double cutoff, center, sum;
+
+    resampler->up = 0;
+    if (!IntegerResamplingRatio(to, fromfreq, &up, &down)) {
+        return SDL_TRUE;
+    }
+
+    /* one filter, ratio * taps long, at the higher of the two rates, cutting
+       off just below the lower rate's Nyquist frequency. Upsampling runs it
+       as (up) filters of (taps) each, one per output phase, as the zeros we
+       stuff in between input frames would make the rest of the taps useless.
+       Downsampling needs all of it for each output frame. */
+    ratio = up * down;
+    len = ratio * taps;
+    histlen = (up > 1) ? (taps - 1) : (len - down);
+    cutoff = (0.5 * INTEGER_RESAMPLER_CUTOFF) / ratio;  /* in cycles per sample at the higher rate. */
+    center = (len - 1) / 2.0;
+    sum = 0.0;
+
+    for (i = 0; i < len; i++) {
+        const double x = i - center;
+        const double window = ResamplerBessel(INTEGER_RESAMPLER_BETA * SDL20_sqrt(1.0 - ((x / (center + 1.0)) * (x / (center + 1.0))))) / ResamplerBessel(INTEGER_RESAMPLER_BETA);
+        const double sinc = (x == 0.0) ? (2.0 * cutoff) : (SDL20_sin(2.0 * M_PI * cutoff * x) / (M_PI * x));
+        const double h = sinc * window;
+        /* taps are stored oldest-input-first, the filter runs newest-first. */
+        if (up > 1) {
+            resampler->coefficients[((i % up) * taps) + (taps - 1 - (i / up))] = (float) h;
+        } else {
+            resampler->coefficients[len - 1 - i] = (float) h;
+        }
+        sum += h;
+    }
+
+    /* unity gain at DC: each upsampling phase sums to 1, downsampling's one filter does too. */
+    for (i = 0; i < len; i++) {
+        resampler->coefficients[i] = (float) (resampler->coefficients[i] * (up / sum));
+    }
+
+    if (!resampler->buffer || (resampler->channels != to->channels) || (resampler->histlen != histlen)) {
+        const size_t alloclen = (INTEGER_RESAMPLER_BLOCK + INTEGER_RESAMPLER_BLOCK + histlen) * to->channels * sizeof (float);
+        void *ptr = SDL20_realloc(resampler->buffer, alloclen);
+        if (!ptr) {
+            return SDL_FALSE;  /* just use the SDL_AudioStream for everything. */
+        }
+        resampler->buffer = (float *) ptr;
+        resampler->planar = resampler->buffer + (INTEGER_RESAMPLER_BLOCK * to->channels);
+    }
+
+    SDL20_memset(resampler->planar, '\0', (INTEGER_RESAMPLER_BLOCK + histlen) * to->channels * sizeof (float));
+    resampler->taps = taps;
+    resampler->histlen = histlen;
+    resampler->channels = to->channels;
+    resampler->dstfmt = to->format;
+    resampler->down = down;
+    resampler->up = up;
+    return SDL_TRUE;
+}
+
+static void
+FreeIntegerResampler(IntegerResampler *resampler)
+{
+    SDL20_free(resampler->buffer);
+    SDL20_zerop(resampler);
+}
+
+static int
+AudioStreamAvailableResampled(SDL_AudioStream *stream, const IntegerResampler *resampler)
+{
+    const int available = SDL20_AudioStreamAvailable(stream);
+    int frames;
+    if (!resampler->up) {
+        return available;
+    }
+    frames = available / (int) (resampler->channels * sizeof (float));
+    return (frames / resampler->down) * resampler->up * resampler->channels * (SDL_AUDIO_BITSIZE(resampler->dstfmt) / 8);
+}
+
+/* the filters are all a multiple of 4 taps long. */
+static SDL_INLINE float
+ResamplerDotProduct(const float *c, const float *x, const int len)
+{
+#ifdef INTEGER_RESAMPLER_SSE
+    __m128 sum = _mm_mul_ps(_mm_loadu_ps(c), _mm_loadu_ps(x));
+    int i;
+    for (i = 4; i < len; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c + i), _mm_loadu_ps(x + i)));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    int i;
+    for (i = 0; i < len; i += 4) {
+        sum0 += c[i] * x[i];
+        sum1 += c[i + 1] * x[i + 1];
+        sum2 += c[i + 2] * x[i + 2];
+        sum3 += c[i + 3] * x[i + 3];
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+#endif
+}
+
+/* the block of input in resampler->buffer is float32 frames at the source rate,
+   a multiple of resampler->down; output goes to dst in resampler->dstfmt. */
+static void
+RunIntegerResampler(IntegerResampler *resampler, const int srcframes, Uint8 *dst)
+{
+    const int up = resampler->up;
+    const int down = resampler->down;
+    const int taps = resampler->taps;
+    const int histlen = resampler->histlen;
+    const int channels = (int) resampler->channels;
+    const int planarlen = histlen + INTEGER_RESAMPLER_BLOCK;
+    const int groups = srcframes / down;
+    float *dstf = (float *) dst;
+    Sint16 *dsts = (Sint16 *) dst;
+    const SDL_bool tofloat = (resampler->dstfmt == AUDIO_F32SYS) ? SDL_TRUE : SDL_FALSE;
+    int i, chan;
+
+    for (chan = 0; chan < channels; chan++) {
+        float *planar = resampler->planar + (chan * planarlen);
+        const float *src = resampler->buffer + chan;
+        float *x = planar + histlen;
+        for (i = 0; i < srcframes; i++) {
+            x[i] = src[i * channels];
+        }
+
+        /* each group of (down) input frames makes (up) output frames, one per phase of the filter. */
+        for (i = 0; i < groups; i++) {
+            const float *window = planar + (i * down);
+            int phase;
+            for (phase = 0; phase < up; phase++) {
+                const float f = ResamplerDotProduct(resampler->coefficients + (phase * taps), window, taps * down);
+                const int idx = (((i * up) + phase) * channels) + chan;
+                if (tofloat) {
+                    dstf[idx] = f;
+                } else {
+                    dsts[idx] = (f >= 1.0f) ? 32767 : (f <= -1.0f) ? -32768 : (Sint16) (f * 32767.0f);
+                }
+            }
+        }
+
+        SDL20_memmove(planar, planar + srcframes, histlen * sizeof (float));  /* keep the newest frames for next time. */
+    }
+}
+
+static int
+AudioStreamGetResampled(SDL_AudioStream *stream, IntegerResampler *resampler, void *buf, int len)
+{
+    const int srcframesize = (int) (resampler->channels * sizeof (float));
+    int dstgroupsize;  /* bytes of output for each (down) input frames. */
+    Uint8 *dst = (Uint8 *) buf;
+    int total = 0;
+
+    if (!resampler->up) {
+        return SDL20_AudioStreamGet(stream, buf, len);
+    }
+
+    dstgroupsize = resampler->up * resampler->channels * (SDL_AUDIO_BITSIZE(resampler->dstfmt) / 8);
+    while (len >= dstgroupsize) {
+        /* only ask for whole groups of input, so a partial one is never left behind in our buffer. */
+        int srcframes = SDL_min((len / dstgroupsize) * resampler->down, INTEGER_RESAMPLER_BLOCK);
+        srcframes = SDL_min(srcframes, SDL20_AudioStreamAvailable(stream) / srcframesize);
+        srcframes -= srcframes % resampler->down;
+        if (srcframes <= 0) {
+            break;
+        } else if (SDL20_AudioStreamGet(stream, resampler->buffer, srcframes * srcframesize) != (srcframes * srcframesize)) {
+            break;
+        }
+        RunIntegerResampler(resampler, srcframes, dst);
+        dst += (srcframes / resampler->down) * dstgroupsize;
+        len -= (srcframes / resampler->down) * dstgroupsize;
+        total += (srcframes / resampler->down) * dstgroupsize;
+    }
+
+    return total;
+}
+
 static SDL_bool
-ResetAudioStream(SDL_AudioStream **_stream, SDL_AudioSpec *spec, const SDL_AudioSpec *to, const SDL_AudioFormat fromfmt, const Uint8 fromchannels, const int fromfreq)
+ResetAudioStream(SDL_AudioStream **_stream, IntegerResampler *resampler, SDL_AudioSpec *spec, const SDL_AudioSpec *to, const SDL_AudioFormat fromfmt, const Uint8 fromchannels, const int fromfreq)
 {
     if ((!*_stream) || (spec->channels != fromchannels) || (spec->format != fromfmt) || (spec->freq != fromfreq)) {
+        if (!ResetIntegerResampler(resampler, to, fromfreq)) {
+            resampler->up = 0;
+        }
+
         SDL20_FreeAudioStream(*_stream);
-        *_stream = SDL20_NewAudioStream(fromfmt, fromchannels, fromfreq, to->format, to->channels, to->freq);
+        if (resampler->up) {  /* let SDL2 do format and channel conversion only; no resampling. */
+            *_stream = SDL20_NewAudioStream(fromfmt, fromchannels, fromfreq, AUDIO_F32SYS, to->channels, fromfreq);
+        } else {
+            *_stream = SDL20_NewAudioStream(fromfmt, fromchannels, fromfreq, to->format, to->channels, to->freq);
+        }
         if (!*_stream) {
             return SDL_FALSE;
         }
@@ -9970,18 +13812,115 @@ OpenSDL2AudioDevice(SDL_AudioSpec *appwant)
         devwant.format = AUDIO_S16SYS;
     }
 
+    /* The device buffer has the same number of sample frames the app asked
+       for, which is never more time than the app's buffer, since we only
+       ever raise the frequency. AudioCallbackWrapper only runs the app's
+       callback until there's enough for one device callback, so our stream
+       never holds more than one app period on top of that.
+
+       If the app's period isn't a whole number of device periods, though,
+       the leftover in the stream drifts around from callback to callback,
+       and its worst case is nearly a whole extra app period. In low-latency
+       mode, we shrink the device buffer (never grow it!) to the biggest size
+       that divides the app's period evenly, so every app callback covers an
+       exact number of device callbacks and the leftover stays as small as
+       it can be. If there's no reasonable size like that, we leave it be. */
+    if (WantLowLatencyAudio && (appwant->freq > 0)) {
+        const Uint32 appperiod = (Uint32) ((((Uint64) appwant->samples) * devwant.freq) / appwant->freq);  /* in device frames */
+        Uint32 samples;
+        for (samples = SDL_min(appperiod, devwant.samples); samples >= 64; samples--) {
+            if ((appperiod % samples) == 0) {
+                devwant.samples = (Uint16) samples;
+                break;
+            }
+        }
+    }
+
     if (SDL20_OpenAudio(&devwant, &audio_cbdata->device_format) == -1) {
         SDL_free(audio_cbdata);
         audio_cbdata = NULL;
         return SDL_FALSE;
     }
 
+    if (WantDebugLogging) {
+        const SDL_AudioSpec *have = &audio_cbdata->device_format;
+        SDL20_Log("Opened SDL2 audio device: %d Hz, %d channels, %d sample frames per callback (%.2f ms)",
+                  have->freq, (int) have->channels, (int) have->samples, (have->samples * 1000.0) / have->freq);
+    }
+
     SDL20_LockAudio();
     SDL20_PauseAudio(0);  /* always unpause, but caller will unlock after finalizing setup. */
 
     return SDL_TRUE;
 }
 
+/* call with the audio device locked. Returns SDL_FALSE if there's nothing measured yet. */
+static SDL_bool
+MeasureAudioLatency(const AudioCallbackWrapperData *data, double *device_ms, double *buffered_avg_ms, double *buffered_max_ms)
+{
+    const SDL_AudioSpec *have = &data->device_format;
+    const double bytes_per_ms = (have->freq * have->channels * (SDL_AUDIO_BITSIZE(have->format) / 8)) / 1000.0;
+
+    if (!data->latency_callbacks || (bytes_per_ms <= 0.0)) {
+        return SDL_FALSE;
+    }
+
+    *device_ms = (have->samples * 1000.0) / have->freq;
+    *buffered_avg_ms = (((double) data->latency_fifo_total) / data->latency_callbacks) / bytes_per_ms;
+    *buffered_max_ms = data->latency_fifo_max / bytes_per_ms;
+    return SDL_TRUE;
+}
+
+/* call with the audio device locked. */
+static void
+ReportAudioLatency(AudioCallbackWrapperData *data)
+{
+    double device_ms, buffered_avg_ms, buffered_max_ms;
+
+    if (!MeasureAudioLatency(data, &device_ms, &buffered_avg_ms, &buffered_max_ms)) {
+        return;
+    }
+
+    SDL20_Log("Audio latency over %u callbacks: app period %.2f ms, device buffer %.2f ms, buffered app audio avg %.2f ms, max %.2f ms (so %.2f ms worst case total)",
+              (unsigned int) data->latency_callbacks,
+              (data->app_callback_format.samples * 1000.0) / data->app_callback_format.freq,
+              device_ms, buffered_avg_ms, buffered_max_ms,
+              device_ms + buffered_max_ms);
+
+    data->latency_fifo_total = 0;
+    data->latency_fifo_max = 0;
+    data->latency_callbacks = 0;
+}
+
+/* Reports how much of the app's audio is queued up ahead of the speakers,
+   since the app opened the audio device: the device buffer, plus the
+   average and worst case of what was left in our stream after each device
+   callback. Times are in milliseconds; any pointer can be NULL. Returns -1
+   if the app's audio isn't open or hasn't played anything yet. */
+DECLSPEC12 int SDLCALL
+SDL12COMPAT_GetAudioLatency(double *device_ms, double *buffered_avg_ms, double *buffered_max_ms)
+{
+    double dev = 0.0, avg = 0.0, max = 0.0;
+    int retval = -1;
+
+    SDL20_LockAudio();
+    if (audio_cbdata && audio_cbdata->app_callback_opened && MeasureAudioLatency(audio_cbdata, &dev, &avg, &max)) {
+        retval = 0;
+    }
+    SDL20_UnlockAudio();
+
+    if (device_ms) {
+        *device_ms = dev;
+    }
+    if (buffered_avg_ms) {
+        *buffered_avg_ms = avg;
+    }
+    if (buffered_max_ms) {
+        *buffered_max_ms = max;
+    }
+    return retval;
+}
+
 static int
 CloseSDL2AudioDevice(void)
 {
@@ -9993,8 +13932,11 @@ CloseSDL2AudioDevice(void)
 
     if (close_sdl2_device) {
         SDL20_CloseAudio();
+        UnpublishCDStatus();
         SDL20_FreeAudioStream(audio_cbdata->app_callback_stream);
         SDL20_FreeAudioStream(audio_cbdata->cdrom_stream);
+        FreeIntegerResampler(&audio_cbdata->app_callback_resampler);
+        FreeIntegerResampler(&audio_cbdata->cdrom_resampler);
         SDL20_free(audio_cbdata->mix_buffer);
         SDL20_free(audio_cbdata);
         audio_cbdata = NULL;
@@ -10008,6 +13950,7 @@ DECLSPEC12 int SDLCALL
 SDL_OpenAudio(SDL_AudioSpec *want, SDL_AudioSpec *obtained)
 {
     SDL_bool already_opened;
+    Uint64 phase_start;
 
     /* SDL_OpenAudio() will init the subsystem for you if necessary, yuck. */
     if ((InitializedSubsystems20 & SDL_INIT_AUDIO) != SDL_INIT_AUDIO) {
@@ -10087,9 +14030,12 @@ SDL_OpenAudio(SDL_AudioSpec *want, SDL_AudioSpec *obtained)
        has to share with the fake CD-ROM support. This also avoids the risk of
        getting an incompatible device configuration from SDL2. As such,
        the app always gets the format it requests. */
+    phase_start = BeginStartupPhase();
     if (!OpenSDL2AudioDevice(want)) {
+        EndStartupPhase(STARTUP_PHASE_OPEN_AUDIO, phase_start);
         return -1;
     }
+    EndStartupPhase(STARTUP_PHASE_OPEN_AUDIO, phase_start);
 
     /* Device is locked now, unconditionally. Set up some things. */
 
@@ -10101,7 +14047,7 @@ SDL_OpenAudio(SDL_AudioSpec *want, SDL_AudioSpec *obtained)
     SDL20_AtomicSet(&audio_callback_paused, SDL_TRUE);  /* app callback always starts paused after open. */
 
     SDL_assert(audio_cbdata->app_callback_stream == NULL);
-    if (!ResetAudioStream(&audio_cbdata->app_callback_stream, &audio_cbdata->app_callback_format, &audio_cbdata->device_format, want->format, want->channels, want->freq)) {
+    if (!ResetAudioStream(&audio_cbdata->app_callback_stream, &audio_cbdata->app_callback_resampler, &audio_cbdata->app_callback_format, &audio_cbdata->device_format, want->format, want->channels, want->freq)) {
         SDL20_UnlockAudio();  /* make sure CD audio doesn't hang if it's playing. */
         return CloseSDL2AudioDevice();  /* will stay open if CD audio is still playing, cleans up otherwise. */
     }
@@ -10167,6 +14113,9 @@ SDL_CloseAudio(void)
 {
     SDL20_LockAudio();
     if (audio_cbdata) {
+        if (WantDebugLogging && audio_cbdata->app_callback_opened) {
+            ReportAudioLatency(audio_cbdata);
+        }
         audio_cbdata->app_callback_opened = SDL_FALSE;
         SDL20_FreeAudioStream(audio_cbdata->app_callback_stream);
         audio_cbdata->app_callback_stream = NULL;
@@ -10212,27 +14161,115 @@ AudioCVT20to12(const SDL_AudioCVT *cvt20, SDL12_AudioCVT *cvt12)
     return cvt12;
 }
 
+/* Games that convert every sound effect as they play it would otherwise
+   build a new SDL_AudioStream per SDL_ConvertAudio call, so we keep a few
+   around, keyed on the conversion they do, and just clear them between uses.
+   SDL_ConvertAudio can be called from any thread (including the audio
+   callback), so each slot has a tiny lock, and if every slot is busy we
+   just use a temporary stream like we always did. */
+typedef struct
+{
+    SDL_atomic_t inuse;
+    Uint16 src_format;
+    Uint8 src_channels;
+    Uint16 dst_format;
+    Uint8 dst_channels;
+    SDL_AudioStream *stream;
+} CVTStreamCacheEntry;
+
+static CVTStreamCacheEntry CVTStreamCache[8];
+
+static SDL_AudioStream *
+AcquireCVTStream(const Uint16 src_format, const Uint8 src_channels, const Uint16 dst_format, const Uint8 dst_channels, int *slot)
+{
+    CVTStreamCacheEntry *entry;
+    int i;
+
+    for (i = 0; i < (int) SDL_arraysize(CVTStreamCache); i++) {
+        entry = &CVTStreamCache[i];
+        if (SDL20_AtomicCAS(&entry->inuse, 0, 1)) {
+            if (entry->stream && (entry->src_format == src_format) && (entry->src_channels == src_channels) &&
+                (entry->dst_format == dst_format) && (entry->dst_channels == dst_channels)) {
+                *slot = i;
+                return entry->stream;  /* cache hit! */
+            }
+            SDL20_AtomicSet(&entry->inuse, 0);
+        }
+    }
+
+    /* no match; replace whatever's in the first slot we can grab. Start at a different place each time so we don't always replace the same one. */
+    for (i = 0; i < (int) SDL_arraysize(CVTStreamCache); i++) {
+        static SDL_atomic_t next_victim;
+        const int victim = ((unsigned int) SDL20_AtomicAdd(&next_victim, 1)) % SDL_arraysize(CVTStreamCache);
+        entry = &CVTStreamCache[victim];
+        if (SDL20_AtomicCAS(&entry->inuse, 0, 1)) {
+            SDL20_FreeAudioStream(entry->stream);
+            entry->stream = SDL20_NewAudioStream(src_format, src_channels, 44100, dst_format, dst_channels, 44100);  /* don't resample here! */
+            entry->src_format = src_format;
+            entry->src_channels = src_channels;
+            entry->dst_format = dst_format;
+            entry->dst_channels = dst_channels;
+            if (!entry->stream) {
+                SDL20_AtomicSet(&entry->inuse, 0);
+                return NULL;
+            }
+            *slot = victim;
+            return entry->stream;
+        }
+    }
+
+    *slot = -1;  /* everything is busy, use a temporary stream. */
+    return SDL20_NewAudioStream(src_format, src_channels, 44100, dst_format, dst_channels, 44100);  /* don't resample here! */
+}
+
+static void
+ReleaseCVTStream(SDL_AudioStream *stream, const int slot)
+{
+    if (slot < 0) {
+        SDL20_FreeAudioStream(stream);
+    } else {
+        SDL_assert(CVTStreamCache[slot].stream == stream);
+        SDL20_AudioStreamClear(stream);
+        SDL20_AtomicSet(&CVTStreamCache[slot].inuse, 0);
+    }
+}
+
+static void
+FreeCVTStreamCache(void)
+{
+    int i;
+    for (i = 0; i < (int) SDL_arraysize(CVTStreamCache); i++) {
+        CVTStreamCacheEntry *entry = &CVTStreamCache[i];
+        if (SDL20_AtomicCAS(&entry->inuse, 0, 1)) {
+            SDL20_FreeAudioStream(entry->stream);
+            entry->stream = NULL;
+            SDL20_AtomicSet(&entry->inuse, 0);
+        }
+    }
+}
+
 static void SDLCALL
 CompatibilityCVT_RunStream(SDL12_AudioCVT *cvt12, Uint16 format)
 {
     const size_t channel_mash = (size_t) cvt12->filters[SDL_arraysize(cvt12->filters) - 1];
     const Uint8 src_channels = (Uint8) (channel_mash & 0xFF);
     const Uint8 dst_channels = (Uint8) ((channel_mash >> 8) & 0xFF);
+    int slot;
 
     /* use an audiostream, so we can allocate a dynamic buffer for the work, even if the app screwed up their allocation. */
-    SDL_AudioStream *stream = SDL20_NewAudioStream(format, src_channels, 44100, cvt12->dst_format, dst_channels, 44100);  /* don't resample here! */
+    SDL_AudioStream *stream = AcquireCVTStream(format, src_channels, cvt12->dst_format, dst_channels, &slot);
     if (stream == NULL) {
         return;  /* oh well. */
     }
 
     if ((SDL20_AudioStreamPut(stream, cvt12->buf, cvt12->len_cvt) == -1) || (SDL20_AudioStreamFlush(stream) == -1)) {  /* probably out of memory if failed. */
-        SDL20_FreeAudioStream(stream);
+        ReleaseCVTStream(stream, slot);
         return;  /* oh well. */
     }
 
     cvt12->len_cvt = SDL20_AudioStreamAvailable(stream);
     SDL20_AudioStreamGet(stream, cvt12->buf, cvt12->len_cvt);
-    SDL20_FreeAudioStream(stream);
+    ReleaseCVTStream(stream, slot);
 
     if (cvt12->filters[++cvt12->filter_index]) {
         cvt12->filters[cvt12->filter_index](cvt12, cvt12->dst_format);
@@ -10254,29 +14291,65 @@ CompatibilityCVT_Resampler(SDL12_AudioCVT *cvt12, Uint16 format)
 
     if (cvt12->rate_incr < 1.0) {   /* upsampling */
         /*printf("2x Upsampling!\n");*/
-        #define DO_RESAMPLE(typ) \
+        /* We work backwards from the end, so we can do this in-place. Each
+           duplicated pair of samples is written as a single value twice as
+           wide, which is the same bytes in either byte order. */
+        #define DO_RESAMPLE(typ, widetyp, shift) { \
+            const typ *src = (const typ *) (cvt12->buf + cvt12->len_cvt); \
+            widetyp *dst = (widetyp *) (cvt12->buf + (cvt12->len_cvt * 2)); \
+            for (i = cvt12->len_cvt / sizeof (typ); i >= 4; i -= 4) { \
+                const widetyp s0 = (widetyp) src[-1], s1 = (widetyp) src[-2], s2 = (widetyp) src[-3], s3 = (widetyp) src[-4]; \
+                src -= 4; \
+                dst -= 4; \
+                dst[3] = s0 | (s0 << shift); \
+                dst[2] = s1 | (s1 << shift); \
+                dst[1] = s2 | (s2 << shift); \
+                dst[0] = s3 | (s3 << shift); \
+            } \
+            for (; i; i--) { \
+                const widetyp sample = (widetyp) *(--src); \
+                *(--dst) = sample | (sample << shift); \
+            } \
+        }
+        #define DO_RESAMPLE_NARROW(typ) { \
             const typ *src = (const typ *) (cvt12->buf + cvt12->len_cvt); \
             typ *dst = (typ *) (cvt12->buf + (cvt12->len_cvt * 2)); \
             for (i = cvt12->len_cvt / sizeof (typ); i; i--) { \
                 const typ sample = *(--src); \
                 dst -= 2; \
                 dst[0] = dst[1] = sample; \
+            } \
+        }
+        if (((((size_t) cvt12->buf) & 3) != 0) || ((cvt12->len_cvt & 1) != 0)) {  /* unaligned buffer? Do it the slow way. */
+            if (bitsize == 8) {
+                DO_RESAMPLE_NARROW(Uint8);
+            } else if (bitsize == 16) {
+                DO_RESAMPLE_NARROW(Uint16);
             }
-        if (bitsize == 8) {
-            DO_RESAMPLE(Uint8);
+        } else if (bitsize == 8) {
+            DO_RESAMPLE(Uint8, Uint16, 8);
         } else if (bitsize == 16) {
-            DO_RESAMPLE(Uint16);
+            DO_RESAMPLE(Uint16, Uint32, 16);
         }
         #undef DO_RESAMPLE
+        #undef DO_RESAMPLE_NARROW
         cvt12->len_cvt *= 2;
     } else {  /* downsampling. */
         /*printf("2x Downsampling!\n");*/
-        #define DO_RESAMPLE(typ) \
+        #define DO_RESAMPLE(typ) { \
             const typ *src = (const typ *) cvt12->buf; \
             typ *dst = (typ *) cvt12->buf; \
-            for (i = cvt12->len_cvt / (sizeof (typ) * 2); i; i--, src += 2) { \
+            for (i = cvt12->len_cvt / (sizeof (typ) * 2); i >= 4; i -= 4, src += 8, dst += 4) { \
+                const typ s0 = src[0], s1 = src[2], s2 = src[4], s3 = src[6]; \
+                dst[0] = s0; \
+                dst[1] = s1; \
+                dst[2] = s2; \
+                dst[3] = s3; \
+            } \
+            for (; i; i--, src += 2) { \
                 *(dst++) = *src; \
-            }
+            } \
+        }
         if (bitsize == 8) {
             DO_RESAMPLE(Uint8);
         } else if (bitsize == 16) {
@@ -72,7 +72,7 @@ SDL20_SYM(void,AddEventWatch,(SDL_EventFilter a, void *b),(a,b),)
 SDL20_SYM(void,DelEventWatch,(SDL_EventFilter a, void *b),(a,b),)
 SDL20_SYM(Uint8,EventState,(Uint32 a, int b),(a,b),return)
 
-SDL20_SYM(SDL_bool,GetWindowWMInfo,(SDL_Window *a, SDL_SysWMinfo *b),(a,b),)
+SDL20_SYM(SDL_bool,GetWindowWMInfo,(SDL_Window *a, SDL_SysWMinfo *b),(a,b),return)
 
 SDL20_SYM(int,GetNumVideoDisplays,(void),(),return)
 SDL20_SYM(int,GetNumDisplayModes,(int a),(a),return)
@@ -90,6 +90,7 @@ SDL20_SYM(void,DestroyWindow,(SDL_Window *a),(a),)
 SDL20_SYM(void,SetWindowIcon,(SDL_Window *a,SDL_Surface *b),(a,b),)
 SDL20_SYM(int,UpdateWindowSurface,(SDL_Window *a),(a),return)
 SDL20_SYM(SDL_Surface *,GetWindowSurface,(SDL_Window *a),(a),return)
+SDL20_SYM(int,UpdateWindowSurfaceRects,(SDL_Window *a, const SDL_Rect *b, int c),(a,b,c),return)
 SDL20_SYM(void,GetWindowPosition,(SDL_Window *a,int *b, int *c),(a,b,c),)
 SDL20_SYM(void,SetWindowSize,(SDL_Window *a, int b, int c),(a,b,c),)
 SDL20_SYM(void,GetWindowSize,(SDL_Window *a, int *b, int *c),(a,b,c),)
@@ -102,8 +103,8 @@ SDL20_SYM(void,SetWindowGrab,(SDL_Window *a,SDL_bool b),(a,b),)
 SDL20_SYM(SDL_bool,GetWindowGrab,(SDL_Window *a),(a),return)
 SDL20_SYM(void,SetWindowTitle,(SDL_Window *a,const char *b),(a,b),)
 SDL20_SYM(int,SetWindowFullscreen,(SDL_Window *a, Uint32 b),(a,b),return)
-SDL20_SYM(void,SetWindowBordered,(SDL_Window *a, SDL_bool b),(a,b),return)
-SDL20_SYM(void,SetWindowResizable,(SDL_Window *a, SDL_bool b),(a,b),return)
+SDL20_SYM(void,SetWindowBordered,(SDL_Window *a, SDL_bool b),(a,b),)
+SDL20_SYM(void,SetWindowResizable,(SDL_Window *a, SDL_bool b),(a,b),)
 
 SDL20_SYM(SDL_PixelFormat *,AllocFormat,(Uint32 a),(a),return)
 SDL20_SYM(void,FreeFormat,(SDL_PixelFormat *a),(a),)
@@ -115,6 +116,7 @@ SDL20_SYM(int,LockSurface,(SDL_Surface *a),(a),return)
 SDL20_SYM(void,UnlockSurface,(SDL_Surface *a),(a),)
 SDL20_SYM(int,UpperBlit,(SDL_Surface *a,const SDL_Rect *b,SDL_Surface *c, SDL_Rect *d),(a,b,c,d),return)
 SDL20_SYM(int,LowerBlit,(SDL_Surface *a,SDL_Rect *b,SDL_Surface *c, SDL_Rect *d),(a,b,c,d),return)
+SDL20_SYM(int,UpperBlitScaled,(SDL_Surface *a,const SDL_Rect *b,SDL_Surface *c, SDL_Rect *d),(a,b,c,d),return)
 SDL20_SYM(int,SoftStretch,(SDL_Surface *a,const SDL_Rect *b,SDL_Surface *c,const SDL_Rect *d),(a,b,c,d),return)
 SDL20_SYM(int,SetColorKey,(SDL_Surface *a, int b, Uint32 c),(a,b,c),return)
 SDL20_SYM(int,GetColorKey,(SDL_Surface *a, Uint32 *b),(a,b),return)
@@ -152,6 +154,8 @@ SDL20_SYM(Uint32,MapRGBA,(const SDL_PixelFormat *a,Uint8 b,Uint8 c,Uint8 d,Uint8
 SDL20_SYM(void,CalculateGammaRamp,(float a, Uint16 *b),(a,b),)
 SDL20_SYM(Uint32,MasksToPixelFormatEnum,(int a,Uint32 b,Uint32 c,Uint32 d,Uint32 e),(a,b,c,d,e),return)
 SDL20_SYM(SDL_bool,PixelFormatEnumToMasks,(Uint32 a,int *b,Uint32 *c,Uint32 *d,Uint32 *e,Uint32 *f),(a,b,c,d,e,f),return)
+SDL20_SYM(int,ConvertPixels,(int a, int b, Uint32 c, const void *d, int e, Uint32 f, void *g, int h),(a,b,c,d,e,f,g,h),return)
+SDL20_SYM(const char *,GetPixelFormatName,(Uint32 a),(a),return)
 
 SDL20_SYM_PASSTHROUGH(void,SetModState,(SDL_Keymod a),(a),)
 SDL20_SYM_PASSTHROUGH(SDL_Keymod,GetModState,(void),(),return)
@@ -197,6 +201,9 @@ SDL20_SYM_PASSTHROUGH(int,CondWaitTimeout,(SDL_cond *a, SDL_mutex *b, Uint32 c),
 SDL20_SYM(int,AtomicGet,(SDL_atomic_t *a),(a),return)
 SDL20_SYM(int,AtomicSet,(SDL_atomic_t *a, int b),(a,b),return)
 SDL20_SYM(int,AtomicAdd,(SDL_atomic_t *a, int b),(a,b),return)
+SDL20_SYM(SDL_bool,AtomicCAS,(SDL_atomic_t *a, int b, int c),(a,b,c),return)
+SDL20_SYM(void,AtomicLock,(SDL_SpinLock *a),(a),)
+SDL20_SYM(void,AtomicUnlock,(SDL_SpinLock *a),(a),)
 
 SDL20_SYM(SDL_AudioSpec *,LoadWAV_RW,(SDL_RWops *a, int b, SDL_AudioSpec *c, Uint8 **d, Uint32 *e),(a,b,c,d,e),return)
 SDL20_SYM(int,OpenAudio,(SDL_AudioSpec *a, SDL_AudioSpec *b),(a,b),return)
@@ -232,6 +239,8 @@ SDL20_SYM_PASSTHROUGH(SDL_bool,HasAltiVec,(void),(),return)
 SDL20_SYM(SDL_TimerID,AddTimer,(Uint32 a, SDL_TimerCallback b, void *c),(a,b,c),return)
 SDL20_SYM(SDL_bool,RemoveTimer,(SDL_TimerID a),(a),return)
 SDL20_SYM_PASSTHROUGH(Uint32,GetTicks,(void),(),return)
+SDL20_SYM(Uint64,GetPerformanceCounter,(void),(),return)
+SDL20_SYM(Uint64,GetPerformanceFrequency,(void),(),return)
 SDL20_SYM(void,Delay,(Uint32 a),(a),)
 
 SDL20_SYM(SDL_bool,IsGameController,(int a),(a),return)
@@ -257,7 +266,7 @@ SDL20_SYM(Sint16,JoystickGetAxis,(SDL_Joystick *a, int b),(a,b),return)
 SDL20_SYM(Uint8,JoystickGetHat,(SDL_Joystick *a, int b),(a,b),return)
 SDL20_SYM(int,JoystickGetBall,(SDL_Joystick *a, int b, int *c, int *d),(a,b,c,d),return)
 SDL20_SYM(Uint8,JoystickGetButton,(SDL_Joystick *a, int b),(a,b),return)
-SDL20_SYM(void,JoystickClose,(SDL_Joystick *a),(a),return)
+SDL20_SYM(void,JoystickClose,(SDL_Joystick *a),(a),)
 SDL20_SYM(void,LockJoysticks,(void),(),)
 SDL20_SYM(void,UnlockJoysticks,(void),(),)
 
@@ -317,13 +326,16 @@ SDL20_SYM(long,lroundf,(float a),(a),return)
 SDL20_SYM(double,fabs,(double a),(a),return)
 SDL20_SYM(double,ceil,(double a),(a),return)
 SDL20_SYM(double,floor,(double a),(a),return)
+SDL20_SYM(double,sin,(double a),(a),return)
+SDL20_SYM(double,sqrt,(double a),(a),return)
 
 SDL20_SYM(int,GetRenderDriverInfo,(int a, SDL_RendererInfo *b),(a,b),return)
 SDL20_SYM(SDL_Renderer *,CreateRenderer,(SDL_Window *a, int b, Uint32 c),(a,b,c),return)
 SDL20_SYM(int,GetRendererInfo,(SDL_Renderer *a, SDL_RendererInfo *b),(a,b),return)
-SDL20_SYM(void,RenderGetScale,(SDL_Renderer *a, float *b, float *c),(a,b,c),return)
-SDL20_SYM(void,RenderGetViewport,(SDL_Renderer *a, SDL_Rect *b),(a,b),return)
+SDL20_SYM(void,RenderGetScale,(SDL_Renderer *a, float *b, float *c),(a,b,c),)
+SDL20_SYM(void,RenderGetViewport,(SDL_Renderer *a, SDL_Rect *b),(a,b),)
 SDL20_SYM(SDL_Texture *,CreateTexture,(SDL_Renderer *a, Uint32 b, int c, int d, int e),(a,b,c,d,e),return)
+SDL20_SYM(SDL_Texture *,CreateTextureFromSurface,(SDL_Renderer *a, SDL_Surface *b),(a,b),return)
 SDL20_SYM(int,LockTexture,(SDL_Texture *a, const SDL_Rect *b, void **c, int *d),(a,b,c,d),return)
 SDL20_SYM(int,LockTextureToSurface,(SDL_Texture *a, const SDL_Rect *b, SDL_Surface **c),(a,b,c),return)
 SDL20_SYM(void,UnlockTexture,(SDL_Texture *a),(a),)
@@ -334,6 +346,8 @@ SDL20_SYM(int,SetRenderDrawColor,(SDL_Renderer *a, Uint8 b, Uint8 c, Uint8 d, Ui
 SDL20_SYM(int,RenderClear,(SDL_Renderer *a),(a),return)
 SDL20_SYM(int,RenderCopy,(SDL_Renderer *a, SDL_Texture *b, const SDL_Rect *c, const SDL_Rect *d),(a,b,c,d),return)
 SDL20_SYM(void,DestroyTexture,(SDL_Texture *a),(a),)
+SDL20_SYM(int,QueryTexture,(SDL_Texture *a, Uint32 *b, int *c, int *d, int *e),(a,b,c,d,e),return)
+SDL20_SYM(int,SetTextureBlendMode,(SDL_Texture *a, SDL_BlendMode b),(a,b),return)
 SDL20_SYM(void,DestroyRenderer,(SDL_Renderer *a),(a),)
 SDL20_SYM(void,RenderPresent,(SDL_Renderer *a),(a),)
 
@@ -387,6 +401,26 @@ OPENGL_SYM(Core,void,glTexImage2D,(GLenum a, GLint b, GLint c, GLsizei d, GLsize
 OPENGL_SYM(Core,void,glTexSubImage2D,(GLenum a, GLint b, GLint c, GLint d, GLsizei e, GLsizei f, GLenum g, GLenum h, const GLvoid *i),(a,b,c,d,e,f,g,h,i),)
 OPENGL_SYM(Core,void,glVertex2i,(GLint a, GLint b),(a,b),)
 OPENGL_SYM(Core,void,glTexCoord2f,(GLfloat a, GLfloat b),(a,b),)
+OPENGL_SYM(Core,void,glDrawArrays,(GLenum a, GLint b, GLsizei c),(a,b,c),)
+OPENGL_SYM(Core,void,glDrawElements,(GLenum a, GLsizei b, GLenum c, const GLvoid *d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glCallList,(GLuint a),(a),)
+OPENGL_SYM(Core,void,glCallLists,(GLsizei a, GLenum b, const GLvoid *c),(a,b,c),)
+OPENGL_SYM(Core,void,glDrawPixels,(GLsizei a, GLsizei b, GLenum c, GLenum d, const GLvoid *e),(a,b,c,d,e),)
+OPENGL_SYM(Core,void,glBitmap,(GLsizei a, GLsizei b, GLfloat c, GLfloat d, GLfloat e, GLfloat f, const GLubyte *g),(a,b,c,d,e,f,g),)
+OPENGL_SYM(Core,void,glRectd,(GLdouble a, GLdouble b, GLdouble c, GLdouble d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glRectdv,(const GLdouble *a, const GLdouble *b),(a,b),)
+OPENGL_SYM(Core,void,glRectf,(GLfloat a, GLfloat b, GLfloat c, GLfloat d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glRectfv,(const GLfloat *a, const GLfloat *b),(a,b),)
+OPENGL_SYM(Core,void,glRecti,(GLint a, GLint b, GLint c, GLint d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glRectiv,(const GLint *a, const GLint *b),(a,b),)
+OPENGL_SYM(Core,void,glRects,(GLshort a, GLshort b, GLshort c, GLshort d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glRectsv,(const GLshort *a, const GLshort *b),(a,b),)
+/* these are newer than OpenGL 1.1, so they might be NULL; we only use them for MSAA resolve tracking shims. */
+OPENGL_SYM(Core,void,glDrawRangeElements,(GLenum a, GLuint b, GLuint c, GLsizei d, GLenum e, const GLvoid *f),(a,b,c,d,e,f),)
+OPENGL_SYM(Core,void,glMultiDrawArrays,(GLenum a, const GLint *b, const GLsizei *c, GLsizei d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glMultiDrawElements,(GLenum a, const GLsizei *b, GLenum c, const GLvoid * const *d, GLsizei e),(a,b,c,d,e),)
+OPENGL_SYM(Core,void,glDrawArraysInstanced,(GLenum a, GLint b, GLsizei c, GLsizei d),(a,b,c,d),)
+OPENGL_SYM(Core,void,glDrawElementsInstanced,(GLenum a, GLsizei b, GLenum c, const GLvoid *d, GLsizei e),(a,b,c,d,e),)
 
 OPENGL_EXT(GL_ARB_framebuffer_object)
 OPENGL_SYM(GL_ARB_framebuffer_object,void,glBindRenderbuffer,(GLenum a, GLuint b),(a,b),)
@@ -319,6 +319,123 @@ void WarpSprite(SDL_Surface *screen, int x, int y)
 	SDL_UpdateRects(screen, 2, updates);
 }
 
+/* Blend sprites with per-pixel alpha onto surfaces that have their own
+   alpha, with sdl12-compat's single-pass kernels off and then on, and make
+   sure the results are identical, and the destination alpha untouched. */
+static Uint32 check_seed = 0x2468ACE0;
+
+static void FillRandom(SDL_Surface *surface, int alpharamp)
+{
+	int x, y;
+
+	for ( y = 0; y < surface->h; ++y ) {
+		Uint8 *row = (Uint8 *)surface->pixels + y*surface->pitch;
+		for ( x = 0; x < surface->w; ++x ) {
+			Uint32 pixel;
+			check_seed = (check_seed * 1103515245) + 12345;
+			pixel = check_seed >> 8;
+			if ( alpharamp ) {
+				/* make sure every alpha value shows up, including 0 and opaque */
+				pixel = (pixel & ~surface->format->Amask) | ((((y*surface->w)+x) << surface->format->Ashift) & surface->format->Amask);
+			}
+			if ( surface->format->BytesPerPixel == 2 ) {
+				((Uint16 *)row)[x] = (Uint16)pixel;
+			} else {
+				((Uint32 *)row)[x] = pixel;
+			}
+		}
+	}
+}
+
+static int CheckDestAlpha(void)
+{
+	static const struct {
+		const char *name;
+		int bpp;
+		Uint32 Rmask, Gmask, Bmask, Amask;
+	} formats[] = {
+		{ "ARGB8888", 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 },
+		{ "ABGR8888", 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 },
+		{ "RGBA4444", 16, 0xF000, 0x0F00, 0x00F0, 0x000F }
+	};
+	static const struct { Sint16 x, y; } spots[] = {
+		{ 5, 7 }, { -10, 40 }, { 60, -20 }, { 70, 70 }
+	};
+	int failures = 0;
+	int f, i, j, y;
+
+	for ( f = 0; f < (int)(sizeof(formats)/sizeof(formats[0])); ++f ) {
+		SDL_Surface *src, *orig, *dst[2];
+		int bad = 0;
+
+		src = SDL_CreateRGBSurface(SDL_SWSURFACE, 64, 64, formats[f].bpp, formats[f].Rmask, formats[f].Gmask, formats[f].Bmask, formats[f].Amask);
+		orig = SDL_CreateRGBSurface(SDL_SWSURFACE, 100, 100, formats[f].bpp, formats[f].Rmask, formats[f].Gmask, formats[f].Bmask, formats[f].Amask);
+		dst[0] = SDL_CreateRGBSurface(SDL_SWSURFACE, 100, 100, formats[f].bpp, formats[f].Rmask, formats[f].Gmask, formats[f].Bmask, formats[f].Amask);
+		dst[1] = SDL_CreateRGBSurface(SDL_SWSURFACE, 100, 100, formats[f].bpp, formats[f].Rmask, formats[f].Gmask, formats[f].Bmask, formats[f].Amask);
+		if ( !src || !orig || !dst[0] || !dst[1] ) {
+			fprintf(stderr, "Couldn't create %s surfaces: %s\n", formats[f].name, SDL_GetError());
+			return(1);
+		}
+		FillRandom(src, 1);
+		FillRandom(orig, 0);
+		SDL_SetAlpha(src, SDL_SRCALPHA, 255);
+
+		for ( i = 0; i < 2; ++i ) {
+			SDL_Rect clip;
+			SDL_putenv(i ? "SDL12COMPAT_DEST_ALPHA_KERNELS=1" : "SDL12COMPAT_DEST_ALPHA_KERNELS=0");
+			for ( y = 0; y < orig->h; ++y ) {  /* a copy, not a blit: orig has SDL_SRCALPHA set. */
+				memcpy((Uint8 *)dst[i]->pixels + y*dst[i]->pitch, (Uint8 *)orig->pixels + y*orig->pitch, orig->w*orig->format->BytesPerPixel);
+			}
+			for ( j = 0; j < (int)(sizeof(spots)/sizeof(spots[0])); ++j ) {
+				SDL_Rect dstrect;
+				dstrect.x = spots[j].x;
+				dstrect.y = spots[j].y;
+				SDL_BlitSurface(src, NULL, dst[i], &dstrect);
+			}
+			/* and once more through a clip rect. */
+			clip.x = 20; clip.y = 30; clip.w = 50; clip.h = 25;
+			SDL_SetClipRect(dst[i], &clip);
+			SDL_BlitSurface(src, NULL, dst[i], NULL);
+			SDL_SetClipRect(dst[i], NULL);
+		}
+
+		for ( y = 0; y < orig->h; ++y ) {
+			const Uint8 *o = (Uint8 *)orig->pixels + y*orig->pitch;
+			const Uint8 *a = (Uint8 *)dst[0]->pixels + y*dst[0]->pitch;
+			const Uint8 *b = (Uint8 *)dst[1]->pixels + y*dst[1]->pitch;
+			int x;
+			if ( memcmp(a, b, orig->w*orig->format->BytesPerPixel) != 0 ) {
+				++bad;
+			}
+			for ( x = 0; x < orig->w; ++x ) {
+				Uint32 opix, bpix;
+				if ( orig->format->BytesPerPixel == 2 ) {
+					opix = ((const Uint16 *)o)[x];
+					bpix = ((const Uint16 *)b)[x];
+				} else {
+					opix = ((const Uint32 *)o)[x];
+					bpix = ((const Uint32 *)b)[x];
+				}
+				if ( (opix ^ bpix) & orig->format->Amask ) {
+					++bad;
+					break;
+				}
+			}
+		}
+
+		printf("%s: %s\n", formats[f].name, bad ? "FAILED" : "identical, destination alpha untouched");
+		if ( bad ) {
+			++failures;
+		}
+
+		SDL_FreeSurface(dst[1]);
+		SDL_FreeSurface(dst[0]);
+		SDL_FreeSurface(orig);
+		SDL_FreeSurface(src);
+	}
+	return(failures ? 1 : 0);
+}
+
 int main(int argc, char *argv[])
 {
 	const SDL_VideoInfo *info;
@@ -330,6 +447,7 @@ int main(int argc, char *argv[])
 	SDL_Event event;
 	SDL_Surface *light;
 	int mouse_pressed;
+	int checkdestalpha = 0;
 	Uint32 ticks, lastticks;
 
 
@@ -384,14 +502,21 @@ int main(int argc, char *argv[])
 		} else
 		if ( strcmp(argv[i], "-fullscreen") == 0 ) {
 			videoflags |= SDL_FULLSCREEN;
+		} else
+		if ( strcmp(argv[i], "-checkdestalpha") == 0 ) {
+			checkdestalpha = 1;
 		} else {
 			fprintf(stderr, 
-			"Usage: %s [-width N] [-height N] [-bpp N] [-warp] [-hw] [-fullscreen]\n",
+			"Usage: %s [-width N] [-height N] [-bpp N] [-warp] [-hw] [-fullscreen] [-checkdestalpha]\n",
 								argv[0]);
 			quit(1);
 		}
 	}
 
+	if ( checkdestalpha ) {
+		quit(CheckDestAlpha());
+	}
+
 	/* Set video mode */
 	if ( (screen=SDL_SetVideoMode(w,h,video_bpp,videoflags)) == NULL ) {
 		fprintf(stderr, "Couldn't set %dx%dx%d video mode: %s\n",
@@ -0,0 +1,242 @@
+/*
+ * Benchmarks the CPU cost of playing audio that has to be resampled.
+ *
+ * This opens the audio device at a low rate (11025Hz by default) and
+ *  feeds it a sine wave for a while, then reports how much CPU time the
+ *  process used. The device almost always runs at 44100Hz or better, so
+ *  nearly all of that is spent converting our audio to the device's rate.
+ *
+ * With sdl12-compat, run this once with SDL12COMPAT_INTEGER_RESAMPLING=1
+ *  and once without, and compare. To compare output quality, run both
+ *  with SDL_AUDIODRIVER=disk and SDL_DISKAUDIOFILE=somefile.raw, and look
+ *  at the two captures in an audio editor (or diff their spectra).
+ *  Use --freq 88200 (or 96000, on a 48000Hz device) to measure
+ *  downsampling instead.
+ *
+ * With --cvt, this instead benchmarks SDL_BuildAudioCVT/SDL_ConvertAudio
+ *  the way games that convert each sound effect as they load it do: a
+ *  "library" of short sounds in various formats is converted to the
+ *  output format over and over, and we report conversions per second.
+ *  With sdl12-compat, compare runs with SDL12COMPAT_COMPATIBILITY_AUDIOCVT=1
+ *  against runs without it.
+ *
+ * Note that clock() counts wall time, not CPU time, on Windows, so the
+ *  CPU numbers there aren't useful.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "SDL.h"
+
+static int testSeconds = 10;
+static int testFreq = 0;  /* 0 == default for the test we're running. */
+static int testChannels = 2;
+
+static double sinePhase = 0.0;
+static Uint32 callbackCount = 0;
+
+static void SDLCALL sine_callback(void *userdata, Uint8 *stream, int len)
+{
+    const SDL_AudioSpec *spec = (const SDL_AudioSpec *) userdata;
+    const double step = (440.0 * 2.0 * 3.14159265358979) / spec->freq;
+    Sint16 *dst = (Sint16 *) stream;
+    const int frames = len / (int) (sizeof (Sint16) * spec->channels);
+    int i, chan;
+
+    for (i = 0; i < frames; i++) {
+        const Sint16 sample = (Sint16) (sin(sinePhase) * 16000.0);
+        for (chan = 0; chan < spec->channels; chan++) {
+            *(dst++) = sample;
+        }
+        sinePhase += step;
+    }
+
+    while (sinePhase > (2.0 * 3.14159265358979)) {
+        sinePhase -= (2.0 * 3.14159265358979);
+    }
+
+    callbackCount++;
+}
+
+/* sdl12-compat can report how much audio is queued between us and the speakers. */
+static void print_audio_latency(void)
+{
+    typedef int (SDLCALL *fnGetAudioLatency)(double *, double *, double *);
+    fnGetAudioLatency pfnGetAudioLatency = (fnGetAudioLatency) SDL_GL_GetProcAddress("SDL12COMPAT_GetAudioLatency");
+    double device_ms, avg_ms, max_ms;
+
+    if (pfnGetAudioLatency == NULL) {
+        return;  /* probably using classic SDL 1.2 */
+    } else if (pfnGetAudioLatency(&device_ms, &avg_ms, &max_ms) == 0) {
+        printf("Latency: device buffer %.2f ms, plus %.2f ms buffered on average (%.2f ms worst case).\n",
+               device_ms, avg_ms, max_ms);
+    }
+}
+
+static int run_resample_test(void)
+{
+    static SDL_AudioSpec spec;
+    clock_t start, end;
+    double cpums;
+    char name[32];
+
+    spec.freq = testFreq;
+    spec.format = AUDIO_S16SYS;
+    spec.channels = testChannels;
+    spec.samples = 1024;
+    spec.callback = sine_callback;
+    spec.userdata = &spec;
+
+    if (SDL_OpenAudio(&spec, NULL) < 0) {
+        fprintf(stderr, "Couldn't open audio: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    printf("Using audio driver: %s\n", SDL_AudioDriverName(name, sizeof (name)));
+    printf("Playing %dHz, %d channel audio for %d seconds...\n",
+           spec.freq, (int) spec.channels, testSeconds);
+
+    start = clock();
+    SDL_PauseAudio(0);
+    SDL_Delay(testSeconds * 1000);
+    print_audio_latency();
+    SDL_CloseAudio();
+    end = clock();
+
+    cpums = (((double) (end - start)) * 1000.0) / CLOCKS_PER_SEC;
+    printf("%u callbacks, %.1f ms of CPU time (%.2f%% of one CPU).\n",
+           (unsigned int) callbackCount, cpums,
+           (cpums / (testSeconds * 1000.0)) * 100.0);
+    return 1;
+}
+
+/* a sound effect library: short sounds in the formats old games shipped. */
+typedef struct
+{
+    Uint16 format;
+    Uint8 channels;
+    int freq;
+    int frames;
+} CVTSound;
+
+static const CVTSound cvtSounds[] = {
+    { AUDIO_U8, 1, 11025, 4410 },
+    { AUDIO_U8, 1, 22050, 11025 },
+    { AUDIO_U8, 2, 22050, 8820 },
+    { AUDIO_S16LSB, 1, 11025, 2205 },
+    { AUDIO_S16LSB, 1, 22050, 22050 },
+    { AUDIO_S16LSB, 2, 22050, 4410 },
+    { AUDIO_S16LSB, 2, 44100, 44100 },
+    { AUDIO_S8, 1, 44100, 8820 },
+};
+
+static int run_cvt_test(void)
+{
+    const int numsounds = (int) (sizeof (cvtSounds) / sizeof (cvtSounds[0]));
+    Uint8 *buffers[sizeof (cvtSounds) / sizeof (cvtSounds[0])];
+    Uint32 lens[sizeof (cvtSounds) / sizeof (cvtSounds[0])];
+    Uint32 conversions = 0;
+    double bytes = 0.0;
+    Uint32 now, start;
+    int i;
+
+    /* SDL_ConvertAudio works in place and can grow the data by len_mult. */
+    for (i = 0; i < numsounds; i++) {
+        const CVTSound *snd = &cvtSounds[i];
+        SDL_AudioCVT cvt;
+        if (SDL_BuildAudioCVT(&cvt, snd->format, snd->channels, snd->freq,
+                              AUDIO_S16SYS, testChannels, testFreq) < 0) {
+            fprintf(stderr, "SDL_BuildAudioCVT failed: %s\n", SDL_GetError());
+            return 0;
+        }
+        lens[i] = snd->frames * snd->channels * ((snd->format & 0xFF) / 8);
+        buffers[i] = (Uint8 *) malloc(lens[i] * (cvt.len_mult > 0 ? cvt.len_mult : 1));
+        if (!buffers[i]) {
+            fprintf(stderr, "Out of memory!\n");
+            while (--i >= 0) {
+                free(buffers[i]);
+            }
+            return 0;
+        }
+    }
+
+    printf("Converting %d sounds to %dHz, %d channels for %d seconds...\n",
+           numsounds, testFreq, testChannels, testSeconds);
+
+    start = now = SDL_GetTicks();
+    while ((now - start) < (Uint32) (testSeconds * 1000)) {
+        for (i = 0; i < numsounds; i++) {
+            const CVTSound *snd = &cvtSounds[i];
+            SDL_AudioCVT cvt;
+            /* games build a fresh cvt per sound, so we do too. */
+            SDL_BuildAudioCVT(&cvt, snd->format, snd->channels, snd->freq,
+                              AUDIO_S16SYS, testChannels, testFreq);
+            memset(buffers[i], 0x40, lens[i]);
+            cvt.buf = buffers[i];
+            cvt.len = (int) lens[i];
+            if (SDL_ConvertAudio(&cvt) < 0) {
+                fprintf(stderr, "SDL_ConvertAudio failed: %s\n", SDL_GetError());
+                break;
+            }
+            bytes += lens[i];
+            conversions++;
+        }
+        now = SDL_GetTicks();
+    }
+
+    printf("%u conversions in %u ms: %.1f conversions/sec, %.2f MB/sec of source audio.\n",
+           (unsigned int) conversions, (unsigned int) (now - start),
+           (conversions * 1000.0) / (now - start),
+           ((bytes / (1024.0 * 1024.0)) * 1000.0) / (now - start));
+
+    for (i = 0; i < numsounds; i++) {
+        free(buffers[i]);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int cvttest = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if ((strcmp(arg, "--seconds") == 0) && (i < argc - 1))
+            testSeconds = atoi(argv[++i]);
+        else if ((strcmp(arg, "--freq") == 0) && (i < argc - 1))
+            testFreq = atoi(argv[++i]);
+        else if ((strcmp(arg, "--channels") == 0) && (i < argc - 1))
+            testChannels = atoi(argv[++i]);
+        else if (strcmp(arg, "--cvt") == 0)
+            cvttest = 1;
+        else {
+            fprintf(stderr, "USAGE: %s [--cvt] [--seconds N] [--freq N] [--channels N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (testFreq == 0)
+        testFreq = cvttest ? 44100 : 11025;
+
+    if ((testSeconds <= 0) || (testFreq <= 0) || (testChannels < 1) || (testChannels > 2)) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+        fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    i = (cvttest ? run_cvt_test() : run_resample_test()) ? 0 : 2;
+    SDL_Quit();
+    return i;
+}
+
+/* end of testaudiospeed.c ... */
+
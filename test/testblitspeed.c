@@ -255,6 +255,13 @@ static int setup_test(int argc, char **argv)
             screenSurface = 1;
         else if (strcmp(arg, "--dumpfile") == 0)
             dumpfile = argv[++i];
+        else if (strcmp(arg, "--threads") == 0)
+        {
+            /* sdl12-compat can split big fills across threads (blits always run on one). */
+            static char threadsenv[64];
+            sprintf(threadsenv, "SDL12COMPAT_BLIT_THREADS=%d", atoi(argv[++i]));
+            SDL_putenv(threadsenv);
+        }
         /* !!! FIXME: set colorkey. */
         else if (0)  /* !!! FIXME: we handle some commandlines elsewhere now */
         {
@@ -0,0 +1,150 @@
+/*
+ * Benchmarks the per-call overhead of cheap SDL 1.2 functions.
+ *
+ * Each function is called over and over on tiny (or no) data, so what's
+ *  measured is mostly the cost of getting into and out of the library.
+ *
+ * With sdl12-compat, run this against a default build (which loads SDL2
+ *  at runtime and calls it through function pointers) and a DIRECTSDL2
+ *  build (which calls a static SDL2 directly), and compare. Use
+ *  SDL_VIDEODRIVER=dummy to keep the window system out of it.
+ *
+ * Note that clock() counts wall time, not CPU time, on Windows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+
+static int testCalls = 1000000;
+
+static SDL_Surface *srcSurface = NULL;
+static SDL_Surface *dstSurface = NULL;
+static volatile Uint32 sink = 0;  /* so the calls can't be optimized out. */
+
+static void call_getticks(void)
+{
+    sink += SDL_GetTicks();
+}
+
+static void call_pollevent(void)
+{
+    SDL_Event event;
+    sink += (Uint32) SDL_PollEvent(&event);
+}
+
+static void call_lockunlock(void)
+{
+    SDL_LockSurface(dstSurface);
+    SDL_UnlockSurface(dstSurface);
+}
+
+static void call_maprgb(void)
+{
+    sink += SDL_MapRGB(dstSurface->format, 0x12, 0x34, 0x56);
+}
+
+static void call_fillrect(void)
+{
+    SDL_Rect rect;
+    rect.x = rect.y = 0;
+    rect.w = rect.h = 1;
+    SDL_FillRect(dstSurface, &rect, 0);
+}
+
+static void call_blit(void)
+{
+    SDL_Rect srcrect, dstrect;
+    srcrect.x = srcrect.y = dstrect.x = dstrect.y = 0;
+    srcrect.w = srcrect.h = 1;
+    SDL_BlitSurface(srcSurface, &srcrect, dstSurface, &dstrect);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fn)(void);
+} CallTest;
+
+static const CallTest callTests[] = {
+    { "SDL_GetTicks", call_getticks },
+    { "SDL_PollEvent", call_pollevent },
+    { "SDL_LockSurface+SDL_UnlockSurface", call_lockunlock },
+    { "SDL_MapRGB", call_maprgb },
+    { "SDL_FillRect (1x1)", call_fillrect },
+    { "SDL_BlitSurface (1x1)", call_blit },
+};
+
+static void run_call_test(const CallTest *test)
+{
+    clock_t start, end;
+    double ns;
+    int i;
+
+    for (i = 0; i < 1000; i++) {  /* warm up caches and anything lazily set up. */
+        test->fn();
+    }
+
+    start = clock();
+    for (i = 0; i < testCalls; i++) {
+        test->fn();
+    }
+    end = clock();
+
+    ns = (((double) (end - start)) * 1000000000.0) / (((double) CLOCKS_PER_SEC) * testCalls);
+    printf("%-36s %8.1f ns per call\n", test->name, ns);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if ((strcmp(arg, "--calls") == 0) && (i < argc - 1))
+            testCalls = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "USAGE: %s [--calls N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (testCalls <= 0) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    if (SDL_SetVideoMode(64, 64, 32, SDL_SWSURFACE) == NULL) {
+        fprintf(stderr, "SDL_SetVideoMode failed: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    srcSurface = SDL_CreateRGBSurface(SDL_SWSURFACE, 16, 16, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    dstSurface = SDL_CreateRGBSurface(SDL_SWSURFACE, 16, 16, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    if ((srcSurface == NULL) || (dstSurface == NULL)) {
+        fprintf(stderr, "SDL_CreateRGBSurface failed: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    printf("%d calls each:\n", testCalls);
+    for (i = 0; i < (int) (sizeof (callTests) / sizeof (callTests[0])); i++) {
+        run_call_test(&callTests[i]);
+    }
+
+    SDL_FreeSurface(srcSurface);
+    SDL_FreeSurface(dstSurface);
+    SDL_Quit();
+    return 0;
+}
+
+/* end of testcallspeed.c ... */
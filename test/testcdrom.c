@@ -76,6 +76,82 @@ static void ListTracks(SDL_CD *cdrom)
 	}
 }
 
+/* Timing of the audio callback while we hammer SDL_CDStatus(). With
+   sdl12-compat, app audio and CD audio are mixed in the same audio thread,
+   so if status polling made that thread wait, it shows up here. */
+static volatile Uint32 callback_count = 0;
+static volatile Uint32 callback_last = 0;
+static volatile Uint32 callback_longest_gap = 0;
+
+static void SDLCALL LatencyCallback(void *userdata, Uint8 *stream, int len)
+{
+	const Uint32 now = SDL_GetTicks();
+	SDL_AudioSpec *spec = (SDL_AudioSpec *) userdata;
+	if ( callback_count && ((now - callback_last) > callback_longest_gap) ) {
+		callback_longest_gap = now - callback_last;
+	}
+	callback_last = now;
+	++callback_count;
+	memset(stream, spec->silence, len);
+}
+
+/* Call SDL_CDStatus() as fast as possible for a while, like a game polling
+   every frame would, and make sure what it reports stays sane while the
+   audio thread is updating it. */
+static void HammerStatus(SDL_CD *cdrom, Uint32 ms)
+{
+	static SDL_AudioSpec spec;
+	Uint32 start, now, slowest = 0;
+	Uint32 calls = 0, errors = 0;
+	int last_track = -1, last_frame = -1;
+	int have_audio = 0;
+
+	callback_count = callback_last = callback_longest_gap = 0;
+	spec.freq = 44100;
+	spec.format = AUDIO_S16SYS;
+	spec.channels = 2;
+	spec.samples = 1024;
+	spec.callback = LatencyCallback;
+	spec.userdata = &spec;
+	if ( (SDL_InitSubSystem(SDL_INIT_AUDIO) == 0) &&
+	     (SDL_OpenAudio(&spec, NULL) == 0) ) {
+		have_audio = 1;
+		SDL_PauseAudio(0);
+	} else {
+		printf("Couldn't open audio, not measuring callback latency: %s\n", SDL_GetError());
+	}
+
+	start = SDL_GetTicks();
+	do {
+		Uint32 before = SDL_GetTicks();
+		CDstatus status = SDL_CDStatus(cdrom);
+		now = SDL_GetTicks();
+		if ( (now - before) > slowest ) {
+			slowest = now - before;
+		}
+		++calls;
+		if ( status == CD_PLAYING ) {
+			/* the frame should only go backwards if we moved to a new track. */
+			if ( (cdrom->cur_track == last_track) &&
+			     (cdrom->cur_frame < last_frame) ) {
+				++errors;
+			}
+			last_track = cdrom->cur_track;
+			last_frame = cdrom->cur_frame;
+		}
+	} while ( (now - start) < ms );
+
+	printf("SDL_CDStatus: %u calls in %u ms, slowest call %u ms, %u inconsistent results\n",
+		calls, ms, slowest, errors);
+
+	if ( have_audio ) {
+		SDL_CloseAudio();
+		printf("Audio callback: %u calls, expected every %u ms, longest gap %u ms\n",
+			callback_count, (Uint32) ((spec.samples * 1000) / spec.freq),
+			callback_longest_gap);
+	}
+}
+
 static void PrintUsage(char *argv0)
 {
 	fprintf(stderr, "Usage: %s [drive#] [command] [command] ...\n", argv0);
@@ -88,6 +164,7 @@ static void PrintUsage(char *argv0)
 	fprintf(stderr, "	-stop\n");
 	fprintf(stderr, "	-eject\n");
 	fprintf(stderr, "	-sleep <milliseconds>\n");
+	fprintf(stderr, "	-hammer <milliseconds>\n");
 }
 
 int main(int argc, char *argv[])
@@ -195,6 +272,10 @@ int main(int argc, char *argv[])
 				(argv[i+1] && isdigit(argv[i+1][0])) ) {
 			SDL_Delay(atoi(argv[++i]));
 			printf("Delayed %d milliseconds\n", atoi(argv[i]));
+		} else
+		if ( (strcmp(argv[i], "-hammer") == 0) &&
+				(argv[i+1] && isdigit(argv[i+1][0])) ) {
+			HammerStatus(cdrom, (Uint32) atoi(argv[++i]));
 		} else {
 			PrintUsage(argv[0]);
 			SDL_CDClose(cdrom);
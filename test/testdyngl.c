@@ -92,6 +92,38 @@ void init_glfuncs(glfuncs* f)
 	f->glFogf=get_funcaddr("glFogf");
 }
 
+/* Resolve a pile of names the way an extension loader (GLEW and friends) does
+   at startup, and report how long it took. Missing names are fine here. */
+void time_lookups(void)
+{
+	static const char *names[] = {
+		"glBegin", "glEnd", "glVertex3f", "glClearColor", "glClear",
+		"glDisable", "glEnable", "glColor4ub", "glPointSize", "glHint",
+		"glBlendFunc", "glMatrixMode", "glLoadIdentity", "glOrtho",
+		"glRotatef", "glViewport", "glFogf", "glReadPixels",
+		"glCopyTexImage2D", "glCopyTexSubImage2D", "glBindFramebuffer",
+		"glBindFramebufferEXT", "glGenFramebuffers", "glBindTexture",
+		"glTexImage2D", "glTexSubImage2D", "glGenBuffers", "glBindBuffer",
+		"glBufferData", "glCreateShader", "glShaderSource",
+		"glCompileShader", "glUseProgram", "glNotARealFunctionEXT"
+	};
+	const int rounds=100;
+	Uint32 start;
+	int i, j;
+
+	start=SDL_GetTicks();
+	for(i=0;i<rounds;i++)
+	{
+		for(j=0;j<(int)(sizeof(names)/sizeof(names[0]));j++)
+		{
+			SDL_GL_GetProcAddress(names[j]);
+		}
+	}
+	printf("Resolved %d names %d times in %u ms\n",
+		(int)(sizeof(names)/sizeof(names[0])),rounds,
+		(unsigned int)(SDL_GetTicks()-start));
+}
+
 #define NB_PIXELS 1000
 
 int main(int argc,char *argv[])
@@ -135,6 +167,7 @@ int main(int argc,char *argv[])
 	SDL_WM_SetCaption( "SDL Dynamic OpenGL Loading Test", "testdyngl" );
 
 	init_glfuncs(&f);
+	time_lookups();
 
 	for(i=0;i<NB_PIXELS;i++)
 	{
@@ -286,6 +286,8 @@ int main(int argc, char **argv)
     SDL_Rect overlayrect;
     SDL_Event event;
     Uint32 lastftick;
+    Uint32 startftick;
+    Uint32 frames=0;
     int paused=0;
     int resized=0;
     int i;
@@ -509,6 +511,7 @@ int main(int argc, char **argv)
     SDL_EventState(SDL_KEYUP, SDL_IGNORE);
 
     lastftick=SDL_GetTicks();
+    startftick=lastftick;
 
     /* Loop, waiting for QUIT or RESIZE */
     while (1)
@@ -541,6 +544,12 @@ int main(int argc, char **argv)
                          break;
                      }
                 case SDL_QUIT:
+                     lastftick=SDL_GetTicks()-startftick;
+                     if (lastftick)
+                     {
+                         printf("Displayed %u frames in %u ms (%.1f frames per second)\n",
+                                (unsigned) frames, (unsigned) lastftick, (frames*1000.0)/lastftick);
+                     }
                      SDL_FreeYUVOverlay(overlay);
                      for (i=0; i<MOOSEFRAMES_COUNT; i++)
                      {
@@ -576,6 +585,7 @@ int main(int argc, char **argv)
                 }
 
                 SDL_DisplayYUVOverlay(overlay, &overlayrect);
+                frames++;
                 if (!resized)
                 {
                     i++;
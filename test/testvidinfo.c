@@ -82,6 +82,7 @@ int RunModeTests(SDL_Surface *screen)
 	int i;
 	Uint8 r, g, b;
 	SDL_Surface *bmp, *bmpcc, *tmp;
+	SDL_Surface **surfaces;
 	SDL_Event event;
 
 	while ( SDL_PollEvent(&event) ) {
@@ -125,6 +126,47 @@ int RunModeTests(SDL_Surface *screen)
 		printf("%d fills and flips in zero seconds!n", frames);
 	}
 
+	/* Test pixel format conversion speed */
+	printf("Running MapRGB/GetRGB test\n");
+	then = SDL_GetTicks();
+	frames = 0;
+	for ( i = 0; i < 1000000; ++i ) {
+		Uint32 pixel = SDL_MapRGB(screen->format, (Uint8)i, (Uint8)(i >> 8), (Uint8)(i >> 16));
+		SDL_GetRGB(pixel, screen->format, &r, &g, &b);
+		frames += r;  /* keep the compiler from throwing this away */
+	}
+	now = SDL_GetTicks();
+	seconds = (float)(now - then) / 1000.0f;
+	if ( seconds > 0.0f ) {
+		printf("%d MapRGB/GetRGB pairs in %2.2f seconds, %2.2f calls per second\n", i, seconds, (float)(i * 2) / seconds);
+	} else {
+		printf("%d MapRGB/GetRGB pairs in zero seconds!\n", i);
+	}
+
+	/* Test surface create/free speed */
+	printf("Running surface create/free test\n");
+	surfaces = (SDL_Surface **)malloc(100000 * sizeof (SDL_Surface *));
+	if ( surfaces ) {
+		then = SDL_GetTicks();
+		for ( i = 0; i < 100000; ++i ) {
+			surfaces[i] = SDL_CreateRGBSurface(SDL_SWSURFACE, 8, 8,
+				screen->format->BitsPerPixel, screen->format->Rmask,
+				screen->format->Gmask, screen->format->Bmask,
+				screen->format->Amask);
+		}
+		for ( i = 0; i < 100000; ++i ) {
+			SDL_FreeSurface(surfaces[i]);
+		}
+		now = SDL_GetTicks();
+		free(surfaces);
+		seconds = (float)(now - then) / 1000.0f;
+		if ( seconds > 0.0f ) {
+			printf("%d surfaces created and freed in %2.2f seconds, %2.2f per second\n", i, seconds, (float)i / seconds);
+		} else {
+			printf("%d surfaces created and freed in zero seconds!\n", i);
+		}
+	}
+
         /* clear the screen after fill test */
         SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0, 0, 0));
 	SDL_Flip(screen);
@@ -383,6 +425,28 @@ void RunVideoTests()
 	}
 }
 
+/* sdl12-compat can report how long the parts of SDL_Init and SDL_SetVideoMode took. */
+void PrintStartupPhases(void)
+{
+	typedef int (SDLCALL *fnGetStartupPhase)(int, const char **, double *, double *, Uint32 *);
+	fnGetStartupPhase pfnGetStartupPhase = (fnGetStartupPhase) SDL_GL_GetProcAddress("SDL12COMPAT_GetStartupPhase");
+	const char *name;
+	double last_ms, total_ms;
+	Uint32 count;
+	int i;
+
+	if ( pfnGetStartupPhase == NULL ) {
+		return;  /* probably using classic SDL 1.2 */
+	}
+
+	printf("Startup phases:\n");
+	for ( i = 0; pfnGetStartupPhase(i, &name, &last_ms, &total_ms, &count) == 0; ++i ) {
+		if ( count > 0 ) {
+			printf("\t%s: %.3f ms (%.3f ms total over %u runs)\n", name, last_ms, total_ms, (unsigned int) count);
+		}
+	}
+}
+
 int main(int argc, char *argv[])
 {
 	const SDL_VideoInfo *info;
@@ -460,6 +524,8 @@ int main(int argc, char *argv[])
 		RunVideoTests();
 	}
 
+	PrintStartupPhases();
+
 	SDL_Quit();
 	return(0);
 }